@@ -0,0 +1,1245 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "docopt-rt.h"
+
+static void *docopt_stdalloc(void *ctx, size_t size)
+{
+	return malloc(size);
+}
+
+static void *docopt_stdrealloc(void *ctx, void *ptr, size_t size)
+{
+	return realloc(ptr, size);
+}
+
+static void docopt_stdfree(void *ctx, void *ptr)
+{
+	free(ptr);
+}
+
+const struct docopt_allocator docopt_stdallocator = {
+	.alloc   = docopt_stdalloc,
+	.realloc = docopt_stdrealloc,
+	.free    = docopt_stdfree,
+};
+
+static void *docopt_noalloc(void *ctx, size_t size)
+{
+	return NULL;
+}
+
+static void *docopt_norealloc(void *ctx, void *ptr, size_t size)
+{
+	return NULL;
+}
+
+static void docopt_nofree(void *ctx, void *ptr)
+{
+}
+
+const struct docopt_allocator docopt_noallocator = {
+	.alloc   = docopt_noalloc,
+	.realloc = docopt_norealloc,
+	.free    = docopt_nofree,
+};
+
+/*
+ * Each block of the arena is prefixed with its size, so the last block
+ * can be grown or released in place and others can be copied on realloc.
+ */
+#define DOCOPT_ARENA_ALIGN (2 * sizeof(size_t))
+
+void *docopt_arenaalloc(void *ctx, size_t size)
+{
+	struct docopt_arena *arena = ctx;
+	uintptr_t ptr;
+	size_t off;
+
+	ptr = (uintptr_t)arena->buf + arena->off + sizeof(size_t);
+	ptr = (ptr + DOCOPT_ARENA_ALIGN - 1) & ~(uintptr_t)(DOCOPT_ARENA_ALIGN - 1);
+	off = ptr - (uintptr_t)arena->buf;
+	if (off > arena->size || size > arena->size - off)
+		return NULL;
+	((size_t *)ptr)[-1] = size;
+	arena->off = off + size;
+
+	return (void *)ptr;
+}
+
+void *docopt_arenarealloc(void *ctx, void *ptr, size_t size)
+{
+	struct docopt_arena *arena = ctx;
+	size_t off, oldsz;
+	void *newptr;
+
+	if (ptr == NULL)
+		return docopt_arenaalloc(ctx, size);
+
+	oldsz = ((size_t *)ptr)[-1];
+	off = (char *)ptr - arena->buf;
+	if (off + oldsz == arena->off) {
+		if (size > arena->size - off)
+			return NULL;
+		((size_t *)ptr)[-1] = size;
+		arena->off = off + size;
+
+		return ptr;
+	}
+	newptr = docopt_arenaalloc(ctx, size);
+	if (newptr)
+		memcpy(newptr, ptr, oldsz < size ? oldsz : size);
+
+	return newptr;
+}
+
+void docopt_arenafree(void *ctx, void *ptr)
+{
+	struct docopt_arena *arena = ctx;
+	size_t off;
+
+	if (ptr == NULL)
+		return;
+	off = (char *)ptr - arena->buf;
+	if (off + ((size_t *)ptr)[-1] == arena->off)
+		arena->off = off - sizeof(size_t);
+}
+
+char *docopt_strdup(const struct docopt_allocator *alloc, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *dup;
+
+	dup = alloc->alloc(alloc->ctx, len);
+	if (dup)
+		memcpy(dup, str, len);
+
+	return dup;
+}
+
+int docopt_strpush(const struct docopt_allocator *alloc, char ***arr,
+		   unsigned *num, const char *str)
+{
+	char **newarr = *arr;
+	unsigned n = *num;
+
+	if ((n & (n - 1)) == 0) {
+		newarr = alloc->realloc(alloc->ctx, newarr,
+					sizeof(*newarr) * (n ? n * 2 : 1));
+		if (!newarr)
+			return -ENOMEM;
+		*arr = newarr;
+	}
+	newarr[n] = docopt_strdup(alloc, str);
+	if (!newarr[n])
+		return -ENOMEM;
+	*num = n + 1;
+
+	return 0;
+}
+
+#if defined(__AVX2__)
+typedef __m256i docopt_vec;
+#define DOCOPT_VECLOAD(p) _mm256_load_si256((const __m256i *)(p))
+#define DOCOPT_VECMASK(v, c) \
+	(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)))
+#elif defined(__SSE2__)
+typedef __m128i docopt_vec;
+#define DOCOPT_VECLOAD(p) _mm_load_si128((const __m128i *)(p))
+#define DOCOPT_VECMASK(v, c) \
+	(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)))
+#endif
+
+#ifdef DOCOPT_VECMASK
+/*
+ * NUL and '=' are found by comparing a whole vector at once.  Loads
+ * are aligned, so bytes after NUL are read but a page boundary is
+ * never crossed.
+ */
+__attribute__((no_sanitize_address))
+static void docopt_scanarg(const char *arg, struct docopt_arg *cls)
+{
+	const char *p = (const char *)((uintptr_t)arg & ~(uintptr_t)(sizeof(docopt_vec) - 1));
+	unsigned skip = arg - p, nul, eqm;
+	docopt_vec v;
+
+	cls->eq = UINT_MAX;
+	cls->eqs = 0;
+	for (;; p += sizeof(docopt_vec), skip = 0) {
+		v = DOCOPT_VECLOAD(p);
+		nul = DOCOPT_VECMASK(v, 0) >> skip << skip;
+		eqm = DOCOPT_VECMASK(v, '=') >> skip << skip;
+		/* '=' after NUL is garbage */
+		if (nul)
+			eqm &= (nul & -nul) - 1;
+		if (eqm) {
+			if (cls->eq == UINT_MAX)
+				cls->eq = p - arg + __builtin_ctz(eqm);
+			cls->eqs += __builtin_popcount(eqm);
+		}
+		if (nul)
+			break;
+	}
+	cls->len = p - arg + __builtin_ctz(nul);
+	if (cls->eq == UINT_MAX)
+		cls->eq = cls->len;
+}
+#else
+static void docopt_scanarg(const char *arg, struct docopt_arg *cls)
+{
+	const char *p;
+
+	cls->eq = strcspn(arg, "=");
+	cls->eqs = 0;
+	for (p = arg + cls->eq; *p; p++)
+		cls->eqs += *p == '=';
+	cls->len = p - arg;
+}
+#endif
+
+void docopt_classify(const char *arg, struct docopt_arg *cls)
+{
+	docopt_scanarg(arg, cls);
+	if (cls->len == 0)
+		cls->kind = DOCOPT_ARG_EMPTY;
+	else if (arg[0] != '-')
+		cls->kind = cls->eqs ? DOCOPT_ARG_EQ : DOCOPT_ARG_WORD;
+	else if (arg[1] != '-')
+		cls->kind = DOCOPT_ARG_SHORT;
+	else if (arg[2] == '\0')
+		cls->kind = DOCOPT_ARG_DDASH;
+	else
+		cls->kind = DOCOPT_ARG_LONG;
+}
+
+int docopt_splitword(char **pline, char **pword)
+{
+	char *r = *pline, *w, quote = 0;
+
+	while (*r == ' ' || *r == '\t' || *r == '\n')
+		r++;
+	if (*r == '\0') {
+		*pword = NULL;
+		return 0;
+	}
+	for (*pword = w = r; *r; r++) {
+		if (quote == '\'') {
+			if (*r == '\'')
+				quote = 0;
+			else
+				*w++ = *r;
+		} else if (quote == '"') {
+			if (*r == '"')
+				quote = 0;
+			else if (*r == '\\' && (r[1] == '"' || r[1] == '\\'))
+				*w++ = *++r;
+			else
+				*w++ = *r;
+		} else if (*r == '\'' || *r == '"') {
+			quote = *r;
+		} else if (*r == '\\') {
+			if (r[1] == '\0')
+				return -EINVAL;
+			*w++ = *++r;
+		} else if (*r == ' ' || *r == '\t' || *r == '\n') {
+			r++;
+			break;
+		} else
+			*w++ = *r;
+	}
+	if (quote)
+		return -EINVAL;
+	*w = '\0';
+	*pline = r;
+
+	return 0;
+}
+
+enum {
+	DOCOPT_EL_WORD,
+	DOCOPT_EL_ARG,
+	DOCOPT_EL_ARGS,
+	DOCOPT_EL_FLAG,
+	DOCOPT_EL_OPT,
+};
+
+struct docopt_elem {
+	const char *name;       /* '--name' of '--name=<val>' */
+	unsigned char kind;
+	unsigned char optional;
+};
+
+struct docopt_cmd {
+	struct docopt_cmd *next;        /* next in the bucket */
+	char *usage;
+	char *names;                    /* split copy of the usage line */
+	docopt_handler handler;
+	void *ctx;
+	const char *word;               /* key, "" without command word */
+	unsigned hash;
+	unsigned num;
+	unsigned npos;
+	unsigned char pos[DOCOPT_MAXELEMS]; /* positional elements */
+	struct docopt_elem elems[DOCOPT_MAXELEMS];
+};
+
+/* Name of '--name=<val>' counted by the lines which have it */
+struct docopt_valued {
+	struct docopt_valued *next;
+	unsigned hash;
+	unsigned refs;
+	char name[];
+};
+
+/* FNV-1a of the command word or the option name */
+static unsigned docopt_hash(const char *word)
+{
+	unsigned hash = 2166136261u;
+
+	for (; *word; word++)
+		hash = (hash ^ (unsigned char)*word) * 16777619u;
+
+	return hash;
+}
+
+static int docopt_isname(const char *str, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (!(str[i] >= 'a' && str[i] <= 'z') &&
+		    !(str[i] >= 'A' && str[i] <= 'Z') &&
+		    !(str[i] >= '0' && str[i] <= '9') &&
+		    str[i] != '_' && str[i] != '-' && str[i] != '.')
+			return 0;
+	}
+
+	return len > 0;
+}
+
+/* '<name>' with an optional '...', which is cut */
+static int docopt_parsearg(char *tok, struct docopt_elem *el)
+{
+	size_t len = strlen(tok);
+
+	el->kind = DOCOPT_EL_ARG;
+	if (len > 3 && !strcmp(tok + len - 3, "...")) {
+		el->kind = DOCOPT_EL_ARGS;
+		len -= 3;
+		tok[len] = '\0';
+	}
+	if (len < 3 || tok[len - 1] != '>' || !docopt_isname(tok + 1, len - 2))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int docopt_parseopt(char *tok, struct docopt_elem *el)
+{
+	char *eq = strchr(tok, '=');
+	size_t len = eq ? (size_t)(eq - tok) : strlen(tok);
+
+	el->kind = DOCOPT_EL_FLAG;
+	/* Short options are of one character */
+	if (tok[1] != '-' ? len != 2 || !docopt_isname(tok + 1, 1) :
+	    !docopt_isname(tok + 2, len - 2))
+		return -EINVAL;
+	if (!eq)
+		return 0;
+	el->kind = DOCOPT_EL_OPT;
+	*eq++ = '\0';
+	/* '=<val>...' is taken as often as it is given anyway */
+	len = strlen(eq);
+	if (len > 3 && !strcmp(eq + len - 3, "..."))
+		len -= 3;
+	if (len < 3 || eq[0] != '<' || eq[len - 1] != '>')
+		return -EINVAL;
+
+	return 0;
+}
+
+static int docopt_findname(const struct docopt_cmd *cmd, const char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < cmd->num; i++) {
+		if (!strcmp(cmd->elems[i].name, name))
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Usage line is split in place into names of elements.  Positional
+ * elements keep their order: words and required arguments, then
+ * optional ones, then '<arg>...'.
+ */
+static int docopt_parseusage(struct docopt_cmd *cmd)
+{
+	struct docopt_elem *el;
+	char *tok = cmd->names, *end;
+	int optpos = 0, rc;
+	size_t len;
+
+	for (;;) {
+		tok += strspn(tok, " \t\n");
+		if (*tok == '\0')
+			break;
+		len = strcspn(tok, " \t\n");
+		end = tok + len;
+		if (*end)
+			*end++ = '\0';
+		/* Options end at '--' of argv in any case */
+		if (!strcmp(tok, "--")) {
+			tok = end;
+			continue;
+		}
+		if (cmd->num == DOCOPT_MAXELEMS)
+			return -EINVAL;
+		el = &cmd->elems[cmd->num];
+		el->optional = 0;
+		if (tok[0] == '[') {
+			if (len < 3 || tok[len - 1] != ']')
+				return -EINVAL;
+			el->optional = 1;
+			tok[len - 1] = '\0';
+			tok++;
+		}
+		if (tok[0] == '-')
+			rc = docopt_parseopt(tok, el);
+		else if (tok[0] == '<')
+			rc = docopt_parsearg(tok, el);
+		else {
+			el->kind = DOCOPT_EL_WORD;
+			rc = el->optional || !docopt_isname(tok, strlen(tok)) ?
+				-EINVAL : 0;
+		}
+		if (rc)
+			return rc;
+		el->name = tok;
+		if (docopt_findname(cmd, tok) >= 0)
+			return -EINVAL;
+		if (el->kind <= DOCOPT_EL_ARGS) {
+			/* Nothing follows '<arg>...', nothing required optional */
+			if (cmd->npos && cmd->elems[cmd->pos[cmd->npos - 1]].kind ==
+			    DOCOPT_EL_ARGS)
+				return -EINVAL;
+			if (optpos && !el->optional && el->kind != DOCOPT_EL_ARGS)
+				return -EINVAL;
+			optpos |= el->optional;
+			cmd->pos[cmd->npos++] = cmd->num;
+		}
+		cmd->num++;
+		tok = end;
+	}
+	/* Command word is the key, lines without one have "" */
+	cmd->word = cmd->num && cmd->elems[0].kind == DOCOPT_EL_WORD ? cmd->elems[0].name : "";
+	cmd->hash = docopt_hash(cmd->word);
+
+	return 0;
+}
+
+static struct docopt_valued **docopt_findvalued(const struct docopt_registry *reg,
+						const char *name, unsigned hash)
+{
+	struct docopt_valued **pval;
+
+	pval = &reg->valued[hash & (reg->nvalued - 1)];
+	for (; *pval; pval = &(*pval)->next) {
+		if ((*pval)->hash == hash && !strcmp((*pval)->name, name))
+			break;
+	}
+
+	return pval;
+}
+
+static int docopt_revalue(struct docopt_registry *reg, unsigned nvalued)
+{
+	struct docopt_valued **valued, *val;
+	unsigned i;
+
+	valued = calloc(nvalued, sizeof(*valued));
+	if (!valued)
+		return -ENOMEM;
+	for (i = 0; i < reg->nvalued; i++) {
+		while ((val = reg->valued[i])) {
+			reg->valued[i] = val->next;
+			val->next = valued[val->hash & (nvalued - 1)];
+			valued[val->hash & (nvalued - 1)] = val;
+		}
+	}
+	free(reg->valued);
+	reg->valued = valued;
+	reg->nvalued = nvalued;
+
+	return 0;
+}
+
+/* Options with value of the first 'num' elements of the line are dropped */
+static void docopt_dropvalued(struct docopt_registry *reg,
+			      const struct docopt_cmd *cmd, unsigned num)
+{
+	struct docopt_valued **pval, *val;
+	unsigned i;
+
+	for (i = 0; i < num; i++) {
+		if (cmd->elems[i].kind != DOCOPT_EL_OPT)
+			continue;
+		pval = docopt_findvalued(reg, cmd->elems[i].name,
+					 docopt_hash(cmd->elems[i].name));
+		val = *pval;
+		if (--val->refs)
+			continue;
+		*pval = val->next;
+		free(val);
+		reg->valuednum--;
+	}
+}
+
+static int docopt_addvalued(struct docopt_registry *reg,
+			    const struct docopt_cmd *cmd)
+{
+	unsigned i, hash, nvalued = reg->nvalued ? reg->nvalued : 8;
+	struct docopt_valued **pval, *val;
+	size_t len;
+	int rc;
+
+	/* Load factor is at most 1 with all options of the line added */
+	while (nvalued < reg->valuednum + cmd->num)
+		nvalued *= 2;
+	if (nvalued != reg->nvalued) {
+		rc = docopt_revalue(reg, nvalued);
+		if (rc)
+			return rc;
+	}
+	for (i = 0; i < cmd->num; i++) {
+		if (cmd->elems[i].kind != DOCOPT_EL_OPT)
+			continue;
+		hash = docopt_hash(cmd->elems[i].name);
+		pval = docopt_findvalued(reg, cmd->elems[i].name, hash);
+		if (*pval) {
+			(*pval)->refs++;
+			continue;
+		}
+		len = strlen(cmd->elems[i].name) + 1;
+		val = malloc(sizeof(*val) + len);
+		if (!val) {
+			docopt_dropvalued(reg, cmd, i);
+			return -ENOMEM;
+		}
+		val->next = NULL;
+		val->hash = hash;
+		val->refs = 1;
+		memcpy(val->name, cmd->elems[i].name, len);
+		*pval = val;
+		reg->valuednum++;
+	}
+
+	return 0;
+}
+
+static void docopt_cmdfree(struct docopt_cmd *cmd)
+{
+	free(cmd->usage);
+	free(cmd->names);
+	free(cmd);
+}
+
+static int docopt_rehash(struct docopt_registry *reg, unsigned nbuckets)
+{
+	struct docopt_cmd **buckets, *cmd, **tail;
+	unsigned i;
+
+	buckets = calloc(nbuckets, sizeof(*buckets));
+	if (!buckets)
+		return -ENOMEM;
+	for (i = 0; i < reg->nbuckets; i++) {
+		while ((cmd = reg->buckets[i])) {
+			reg->buckets[i] = cmd->next;
+			/* Order of registration is kept in a bucket */
+			for (tail = &buckets[cmd->hash & (nbuckets - 1)]; *tail;
+			     tail = &(*tail)->next)
+				;
+			cmd->next = NULL;
+			*tail = cmd;
+		}
+	}
+	free(reg->buckets);
+	reg->buckets = buckets;
+	reg->nbuckets = nbuckets;
+
+	return 0;
+}
+
+int docopt_register(struct docopt_registry *reg, const char *usage,
+		    docopt_handler handler, void *ctx)
+{
+	struct docopt_cmd *cmd, **tail;
+	int rc;
+
+	cmd = calloc(1, sizeof(*cmd));
+	if (!cmd)
+		return -ENOMEM;
+	cmd->usage = strdup(usage);
+	cmd->names = strdup(usage);
+	if (!cmd->usage || !cmd->names) {
+		docopt_cmdfree(cmd);
+		return -ENOMEM;
+	}
+	cmd->handler = handler;
+	cmd->ctx = ctx;
+	rc = docopt_parseusage(cmd);
+	if (!rc && reg->num >= reg->nbuckets)
+		rc = docopt_rehash(reg, reg->nbuckets ? reg->nbuckets * 2 : 8);
+	if (rc) {
+		docopt_cmdfree(cmd);
+		return rc;
+	}
+	for (tail = &reg->buckets[cmd->hash & (reg->nbuckets - 1)]; *tail;
+	     tail = &(*tail)->next) {
+		if (!strcmp((*tail)->usage, usage)) {
+			docopt_cmdfree(cmd);
+			return -EEXIST;
+		}
+	}
+	rc = docopt_addvalued(reg, cmd);
+	if (rc) {
+		docopt_cmdfree(cmd);
+		return rc;
+	}
+	*tail = cmd;
+	reg->num++;
+
+	return 0;
+}
+
+int docopt_unregister(struct docopt_registry *reg, const char *usage)
+{
+	struct docopt_cmd *cmd, **prev;
+	unsigned i;
+
+	for (i = 0; i < reg->nbuckets; i++) {
+		for (prev = &reg->buckets[i]; (cmd = *prev); prev = &cmd->next) {
+			if (strcmp(cmd->usage, usage))
+				continue;
+			*prev = cmd->next;
+			docopt_dropvalued(reg, cmd, cmd->num);
+			docopt_cmdfree(cmd);
+			reg->num--;
+
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+void docopt_registryfree(struct docopt_registry *reg)
+{
+	struct docopt_valued *val;
+	struct docopt_cmd *cmd;
+	unsigned i;
+
+	for (i = 0; i < reg->nbuckets; i++) {
+		while ((cmd = reg->buckets[i])) {
+			reg->buckets[i] = cmd->next;
+			docopt_cmdfree(cmd);
+		}
+	}
+	for (i = 0; i < reg->nvalued; i++) {
+		while ((val = reg->valued[i])) {
+			reg->valued[i] = val->next;
+			free(val);
+		}
+	}
+	free(reg->buckets);
+	free(reg->valued);
+	memset(reg, 0, sizeof(*reg));
+}
+
+/* Some line takes the option with a value */
+static int docopt_isvalued(const struct docopt_registry *reg, const char *opt)
+{
+	return reg->nvalued && *docopt_findvalued(reg, opt, docopt_hash(opt));
+}
+
+int docopt_cmdword(const struct docopt_registry *reg, int argc, char **argv)
+{
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--"))
+			break;
+		if (argv[i][0] != '-')
+			return i;
+		/* Value of '--name v' is not the command word */
+		if (!strchr(argv[i], '=') && docopt_isvalued(reg, argv[i]))
+			i++;
+	}
+
+	return 0;
+}
+
+/* Option of the usage line and length of its name in 'arg' */
+static int docopt_findopt(const struct docopt_cmd *cmd, const char *arg,
+			  size_t *len)
+{
+	const struct docopt_elem *el;
+	unsigned i;
+
+	for (i = 0; i < cmd->num; i++) {
+		el = &cmd->elems[i];
+		if (el->kind < DOCOPT_EL_FLAG)
+			continue;
+		*len = strlen(el->name);
+		if (!strncmp(arg, el->name, *len) &&
+		    (arg[*len] == '\0' || arg[*len] == '='))
+			return i;
+	}
+
+	return -1;
+}
+
+/* Arguments of argv which are neither options nor their values */
+static unsigned docopt_countpos(const struct docopt_cmd *cmd, int argc,
+				char **argv)
+{
+	unsigned n = 0;
+	int i, j, ddash = 0;
+	size_t len;
+
+	for (i = 1; i < argc; i++) {
+		if (!ddash && !strcmp(argv[i], "--")) {
+			ddash = 1;
+			continue;
+		}
+		if (!ddash && argv[i][0] == '-' && argv[i][1]) {
+			j = docopt_findopt(cmd, argv[i], &len);
+			if (j >= 0 && cmd->elems[j].kind == DOCOPT_EL_OPT &&
+			    !argv[i][len])
+				i++;
+			continue;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+static int docopt_match(const struct docopt_cmd *cmd, int argc, char **argv,
+			struct docopt_match *m, int *argi)
+{
+	const struct docopt_elem *el;
+	unsigned ipos;
+	int i, j, ddash = 0, spare;
+	const char *val;
+	size_t len;
+
+	m->usage = cmd->usage;
+	m->cmd = cmd;
+	m->argc = argc;
+	m->argv = argv;
+	memset(m->vals, 0, sizeof(m->vals[0]) * cmd->num);
+	memset(m->nums, 0, sizeof(m->nums[0]) * cmd->num);
+	/* Optional arguments take only what required ones leave */
+	spare = docopt_countpos(cmd, argc, argv);
+	for (ipos = 0; ipos < cmd->npos; ipos++)
+		spare -= !cmd->elems[cmd->pos[ipos]].optional;
+	ipos = 0;
+	for (i = 1; i < argc; i++) {
+		if (!ddash && !strcmp(argv[i], "--")) {
+			ddash = 1;
+			continue;
+		}
+		if (!ddash && argv[i][0] == '-' && argv[i][1]) {
+			j = docopt_findopt(cmd, argv[i], &len);
+			if (j < 0)
+				goto fail;
+			el = &cmd->elems[j];
+			if (el->kind == DOCOPT_EL_FLAG && argv[i][len])
+				goto fail;
+			if (el->kind == DOCOPT_EL_FLAG)
+				val = argv[i];
+			else if (argv[i][len])
+				val = argv[i] + len + 1;
+			else if (i + 1 < argc)
+				val = argv[++i];
+			else
+				goto fail;
+			m->vals[j] = val;
+			m->nums[j]++;
+			continue;
+		}
+		while (ipos < cmd->npos && spare <= 0 &&
+		       cmd->elems[cmd->pos[ipos]].optional &&
+		       cmd->elems[cmd->pos[ipos]].kind == DOCOPT_EL_ARG)
+			ipos++;
+		if (ipos == cmd->npos)
+			goto fail;
+		j = cmd->pos[ipos];
+		el = &cmd->elems[j];
+		if (el->kind == DOCOPT_EL_WORD && strcmp(argv[i], el->name))
+			goto fail;
+		if (el->optional && el->kind == DOCOPT_EL_ARG)
+			spare--;
+		if (!m->nums[j])
+			m->vals[j] = argv[i];
+		m->nums[j]++;
+		if (el->kind != DOCOPT_EL_ARGS)
+			ipos++;
+	}
+	for (j = 0; j < (int)cmd->num; j++) {
+		if (!cmd->elems[j].optional && !m->nums[j]) {
+			*argi = argc;
+			return -1;
+		}
+	}
+
+	return 0;
+fail:
+	*argi = i;
+	return -1;
+}
+
+int docopt_dispatchkey(const struct docopt_registry *reg, const char *key,
+		       int argc, char **argv, int *status, int *argi)
+{
+	unsigned hash = docopt_hash(key);
+	struct docopt_match m;
+	struct docopt_cmd *cmd;
+	int found = 0, i;
+
+	*argi = 0;
+	if (!reg->nbuckets)
+		return 0;
+	for (cmd = reg->buckets[hash & (reg->nbuckets - 1)]; cmd;
+	     cmd = cmd->next) {
+		if (cmd->hash != hash || strcmp(cmd->word, key))
+			continue;
+		found = 1;
+		if (docopt_match(cmd, argc, argv, &m, &i) == 0) {
+			*status = cmd->handler(&m, cmd->ctx);
+			return 1;
+		}
+		if (i > *argi)
+			*argi = i;
+	}
+
+	return found ? -1 : 0;
+}
+
+int docopt_dispatch(const struct docopt_registry *reg, int argc,
+		    char **argv, int *status, int *argi)
+{
+	int iword, rc = 0, i;
+
+	if (!reg->nbuckets)
+		return 0;
+	iword = docopt_cmdword(reg, argc, argv);
+	if (iword && argv[iword][0])
+		rc = docopt_dispatchkey(reg, argv[iword], argc, argv, status,
+					argi);
+	if (rc > 0) {
+		*argi = iword;
+		return 1;
+	}
+	/* Lines without command word count only if one matches */
+	if (docopt_dispatchkey(reg, "", argc, argv, status, &i) > 0) {
+		*argi = 0;
+		return 1;
+	}
+
+	return rc;
+}
+
+const char *docopt_matchstr(const struct docopt_match *m, const char *name)
+{
+	int j = docopt_findname(m->cmd, name);
+
+	return j < 0 ? NULL : m->vals[j];
+}
+
+unsigned docopt_matchnum(const struct docopt_match *m, const char *name)
+{
+	int j = docopt_findname(m->cmd, name);
+
+	return j < 0 ? 0 : m->nums[j];
+}
+
+/* Values of '<arg>...' are the last positional arguments */
+const char *docopt_matcharr(const struct docopt_match *m, const char *name,
+			    unsigned i)
+{
+	const struct docopt_cmd *cmd = m->cmd;
+	unsigned ipos = 0;
+	int j, k, ddash = 0;
+	size_t len;
+
+	j = docopt_findname(cmd, name);
+	if (j < 0 || i >= m->nums[j])
+		return NULL;
+	if (cmd->elems[j].kind != DOCOPT_EL_ARGS)
+		return m->vals[j];
+	i += docopt_countpos(cmd, m->argc, m->argv) - m->nums[j];
+	for (k = 1; k < m->argc; k++) {
+		if (!ddash && !strcmp(m->argv[k], "--")) {
+			ddash = 1;
+			continue;
+		}
+		if (!ddash && m->argv[k][0] == '-' && m->argv[k][1]) {
+			j = docopt_findopt(cmd, m->argv[k], &len);
+			if (cmd->elems[j].kind == DOCOPT_EL_OPT && !m->argv[k][len])
+				k++;
+			continue;
+		}
+		if (ipos++ == i)
+			return m->argv[k];
+	}
+
+	return NULL;
+}
+
+/* Flat lines which a usage line with groups stands for */
+struct docopt_alts {
+	char **lines;
+	unsigned num;
+};
+
+#define DOCOPT_MAXALTS 256
+
+static void docopt_altsfree(struct docopt_alts *alts)
+{
+	while (alts->num)
+		free(alts->lines[--alts->num]);
+	free(alts->lines);
+	alts->lines = NULL;
+}
+
+/* Appends 'head' and 'len' bytes of 'tail', separated unless one is empty */
+static int docopt_altspush(struct docopt_alts *alts, const char *head,
+			   const char *tail, size_t len)
+{
+	size_t hlen = strlen(head);
+	char *line;
+	int rc;
+
+	if (alts->num == DOCOPT_MAXALTS)
+		return -E2BIG;
+	line = malloc(hlen + len + 2);
+	if (!line)
+		return -ENOMEM;
+	memcpy(line, head, hlen);
+	if (hlen && len)
+		line[hlen++] = ' ';
+	memcpy(line + hlen, tail, len);
+	line[hlen + len] = '\0';
+	rc = docopt_strpush(&docopt_stdallocator, &alts->lines, &alts->num, line);
+	free(line);
+
+	return rc;
+}
+
+/* Each line of 'alts' is followed by each line of 'tail' */
+static int docopt_altsmul(struct docopt_alts *alts,
+			  const struct docopt_alts *tail)
+{
+	struct docopt_alts prod = { 0 };
+	unsigned i, j;
+	int rc = 0;
+
+	for (i = 0; i < alts->num && !rc; i++) {
+		for (j = 0; j < tail->num && !rc; j++)
+			rc = docopt_altspush(&prod, alts->lines[i], tail->lines[j],
+					     strlen(tail->lines[j]));
+	}
+	docopt_altsfree(alts);
+	if (rc)
+		docopt_altsfree(&prod);
+	*alts = prod;
+
+	return rc;
+}
+
+/*
+ * '[...]' adds the empty line.  An option or an argument alone stays
+ * in brackets, so '[--speed=<kn>]' doesn't double the lines.
+ */
+static int docopt_altsopt(struct docopt_alts *alts)
+{
+	char *line = alts->lines[0];
+	size_t len = strlen(line);
+
+	if (alts->num > 1 || (line[0] != '-' && line[0] != '<') ||
+	    strchr(line, ' '))
+		return docopt_altspush(alts, "", "", 0);
+	line = realloc(line, len + 3);
+	if (!line)
+		return -ENOMEM;
+	memmove(line + 1, line, len);
+	line[0] = '[';
+	line[len + 1] = ']';
+	line[len + 2] = '\0';
+	alts->lines[0] = line;
+
+	return 0;
+}
+
+/*
+ * Lines of a sequence till ')', ']' or the end: branches separated by
+ * '|' are added to 'res', groups multiply the lines of a branch.
+ */
+static int docopt_expand(const char **p, struct docopt_alts *res)
+{
+	struct docopt_alts branch = { 0 }, sub;
+	const char *s;
+	unsigned i;
+	size_t len;
+	int rc;
+
+	rc = docopt_altspush(&branch, "", "", 0);
+	while (!rc) {
+		*p += strspn(*p, " \t");
+		s = *p;
+		if (*s == '\0' || *s == ')' || *s == ']' || *s == '|') {
+			for (i = 0; i < branch.num && !rc; i++)
+				rc = docopt_altspush(res, branch.lines[i], "", 0);
+			docopt_altsfree(&branch);
+			if (rc || *s != '|')
+				break;
+			(*p)++;
+			rc = docopt_altspush(&branch, "", "", 0);
+			continue;
+		}
+		memset(&sub, 0, sizeof(sub));
+		if (*s == '(' || *s == '[') {
+			(*p)++;
+			rc = docopt_expand(p, &sub);
+			if (!rc && **p != (*s == '(' ? ')' : ']'))
+				rc = -EINVAL;
+			if (!rc)
+				(*p)++;
+			if (!rc && *s == '[')
+				rc = docopt_altsopt(&sub);
+		} else {
+			len = strcspn(s, " \t()[]|");
+			*p += len;
+			rc = docopt_altspush(&sub, "", s, len);
+		}
+		if (!rc)
+			rc = docopt_altsmul(&branch, &sub);
+		docopt_altsfree(&sub);
+	}
+	docopt_altsfree(&branch);
+
+	return rc;
+}
+
+/* Lines of 'src' move to 'reg' unless one is there already */
+static int docopt_merge(struct docopt_registry *reg,
+			struct docopt_registry *src)
+{
+	unsigned i, nbuckets = reg->nbuckets ? reg->nbuckets : 8;
+	struct docopt_cmd *cmd, *old, *failed, **tail;
+	int rc;
+
+	for (i = 0; reg->num && i < src->nbuckets; i++) {
+		for (cmd = src->buckets[i]; cmd; cmd = cmd->next) {
+			old = reg->buckets[cmd->hash & (reg->nbuckets - 1)];
+			for (; old; old = old->next) {
+				if (!strcmp(old->usage, cmd->usage))
+					return -EEXIST;
+			}
+		}
+	}
+	while (nbuckets < reg->num + src->num)
+		nbuckets *= 2;
+	if (nbuckets != reg->nbuckets) {
+		rc = docopt_rehash(reg, nbuckets);
+		if (rc)
+			return rc;
+	}
+	/* Options are counted first, this is the last step which can fail */
+	for (i = 0; i < src->nbuckets; i++) {
+		for (cmd = src->buckets[i]; cmd; cmd = cmd->next) {
+			rc = docopt_addvalued(reg, cmd);
+			if (rc)
+				goto drop;
+		}
+	}
+	/* Lines of a word share a bucket, so their order is kept */
+	for (i = 0; i < src->nbuckets; i++) {
+		while ((cmd = src->buckets[i])) {
+			src->buckets[i] = cmd->next;
+			for (tail = &reg->buckets[cmd->hash & (nbuckets - 1)];
+			     *tail; tail = &(*tail)->next)
+				;
+			cmd->next = NULL;
+			*tail = cmd;
+			reg->num++;
+			src->num--;
+		}
+	}
+
+	return 0;
+drop:
+	/* Lines before the failed one are counted */
+	failed = cmd;
+	for (i = 0; i < src->nbuckets; i++) {
+		for (cmd = src->buckets[i]; cmd && cmd != failed; cmd = cmd->next)
+			docopt_dropvalued(reg, cmd, cmd->num);
+		if (cmd == failed)
+			break;
+	}
+
+	return rc;
+}
+
+/*
+ * Lines are registered into a registry of their own, which is merged
+ * only if all of them are, so 'reg' is left as it was on failure.
+ */
+int docopt_registerspec(struct docopt_registry *reg, const char *spec,
+			docopt_handler handler, void *ctx)
+{
+	struct docopt_registry tmp = { 0 };
+	struct docopt_alts alts = { 0 };
+	const char *line = strstr(spec, "Usage:"), *p;
+	int first, rc = 0;
+	char *usage;
+	size_t len;
+	unsigned i;
+
+	if (!line)
+		return -EINVAL;
+	line += strlen("Usage:");
+	/* Lines till the empty one, the first one may follow 'Usage:' */
+	for (first = 1; *line && !rc; first = 0, line += len + !!line[len]) {
+		line += strspn(line, " \t");
+		len = strcspn(line, "\n");
+		if (!len && !first)
+			break;
+		if (!len)
+			continue;
+		usage = strndup(line, len);
+		if (!usage) {
+			rc = -ENOMEM;
+			break;
+		}
+		/* Program name is skipped */
+		p = usage + strcspn(usage, " \t");
+		rc = docopt_expand(&p, &alts);
+		if (!rc && *p)
+			rc = -EINVAL;
+		for (i = 0; i < alts.num && !rc; i++) {
+			rc = docopt_register(&tmp, alts.lines[i], handler, ctx);
+			/* The same line of several alternatives is one */
+			if (rc == -EEXIST)
+				rc = 0;
+		}
+		docopt_altsfree(&alts);
+		free(usage);
+	}
+	if (!rc)
+		rc = docopt_merge(reg, &tmp);
+	docopt_registryfree(&tmp);
+
+	return rc;
+}
+
+/*
+ * Reader enters by counting itself in the slot of the current epoch,
+ * which is checked again, so it can't be counted in a slot a swap has
+ * already waited for.  Swap publishes the new registry, moves to the
+ * next epoch and waits for the slot of the previous one to drain.
+ */
+struct docopt_live {
+	_Atomic(struct docopt_registry *) reg;
+	atomic_ulong epoch;
+	atomic_ulong readers[2];
+	atomic_flag swapping;
+};
+
+struct docopt_live *docopt_livenew(void)
+{
+	struct docopt_live *live = calloc(1, sizeof(*live));
+
+	if (!live)
+		return NULL;
+	atomic_init(&live->reg, NULL);
+	atomic_init(&live->epoch, 0);
+	atomic_init(&live->readers[0], 0);
+	atomic_init(&live->readers[1], 0);
+	atomic_flag_clear(&live->swapping);
+
+	return live;
+}
+
+static void docopt_livedrop(struct docopt_registry *reg)
+{
+	if (!reg)
+		return;
+	docopt_registryfree(reg);
+	free(reg);
+}
+
+void docopt_livefree(struct docopt_live *live)
+{
+	if (!live)
+		return;
+	docopt_livedrop(atomic_load(&live->reg));
+	free(live);
+}
+
+int docopt_liveswap(struct docopt_live *live, struct docopt_registry *reg)
+{
+	struct docopt_registry *new, *old;
+	unsigned long epoch;
+
+	new = malloc(sizeof(*new));
+	if (!new)
+		return -ENOMEM;
+	*new = *reg;
+	memset(reg, 0, sizeof(*reg));
+
+	while (atomic_flag_test_and_set(&live->swapping))
+		sched_yield();
+	old = atomic_exchange(&live->reg, new);
+	epoch = atomic_fetch_add(&live->epoch, 1);
+	while (atomic_load(&live->readers[epoch & 1]))
+		sched_yield();
+	atomic_flag_clear(&live->swapping);
+	docopt_livedrop(old);
+
+	return 0;
+}
+
+int docopt_livedispatch(struct docopt_live *live, int argc, char **argv,
+			int *status, int *argi)
+{
+	struct docopt_registry *reg;
+	unsigned long epoch;
+	int rc = 0;
+
+	for (;;) {
+		epoch = atomic_load(&live->epoch);
+		atomic_fetch_add(&live->readers[epoch & 1], 1);
+		if (atomic_load(&live->epoch) == epoch)
+			break;
+		atomic_fetch_sub(&live->readers[epoch & 1], 1);
+	}
+	reg = atomic_load(&live->reg);
+	if (reg)
+		rc = docopt_dispatch(reg, argc, argv, status, argi);
+	atomic_fetch_sub(&live->readers[epoch & 1], 1);
+
+	return rc;
+}
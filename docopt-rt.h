@@ -0,0 +1,201 @@
+#ifndef DOCOPT_RT_H
+#define DOCOPT_RT_H
+
+/*
+ * Runtime shared by command line parsers generated by 'docopt --runtime'.
+ * Only spec independent code lives here: allocators, copies of argument
+ * strings, classification of arguments, splitting of lines and the
+ * registry of commands added at runtime.  The ABI is changed only
+ * together with DOCOPT_RT_ABI and the soname.
+ */
+
+#include <stddef.h>
+
+#define DOCOPT_RT_ABI 1
+
+/*
+ * Same layout as 'struct cli_allocator' of a generated header, which is
+ * an alias of this one in the runtime mode.
+ */
+struct docopt_allocator {
+	void *(*alloc)(void *ctx, size_t size);
+	void *(*realloc)(void *ctx, void *ptr, size_t size);
+	void (*free)(void *ctx, void *ptr);
+	void *ctx;
+};
+
+/* malloc(3) family and the one which never allocates or frees */
+extern const struct docopt_allocator docopt_stdallocator;
+extern const struct docopt_allocator docopt_noallocator;
+
+/*
+ * Bump allocator over caller provided storage, 'ctx' of the allocator
+ * is a pointer to the arena.
+ */
+struct docopt_arena {
+	char *buf;
+	size_t size;
+	size_t off;
+};
+
+void *docopt_arenaalloc(void *ctx, size_t size);
+void *docopt_arenarealloc(void *ctx, void *ptr, size_t size);
+void docopt_arenafree(void *ctx, void *ptr);
+
+/*
+ * Copy of a string, NULL if the allocation fails.  docopt_strpush()
+ * appends a copy to an array of 'num' elements, which grows each time
+ * 'num' reaches a power of two, and returns -ENOMEM on failure.
+ */
+char *docopt_strdup(const struct docopt_allocator *alloc, const char *str);
+int docopt_strpush(const struct docopt_allocator *alloc, char ***arr,
+		   unsigned *num, const char *str);
+
+/* Classes of arguments, see docopt_classify() */
+enum {
+	DOCOPT_ARG_EMPTY,
+	DOCOPT_ARG_WORD,        /* positional argument without '=' */
+	DOCOPT_ARG_EQ,          /* positional argument with '=' */
+	DOCOPT_ARG_SHORT,       /* '-' and anything */
+	DOCOPT_ARG_LONG,        /* '--' and anything */
+	DOCOPT_ARG_DDASH,       /* bare '--' */
+};
+
+struct docopt_arg {
+	unsigned len;
+	unsigned eq;            /* offset of the first '=' or len */
+	unsigned eqs;           /* number of '=' */
+	unsigned char kind;
+};
+
+void docopt_classify(const char *arg, struct docopt_arg *cls);
+
+/*
+ * Splits the next word of the line in place: quotes and escapes are
+ * removed and the word is terminated with NUL.  The word is NULL at
+ * the end of the line.
+ */
+int docopt_splitword(char **pline, char **pword);
+
+/*
+ * Registry of commands added at runtime, e.g. by plugins.  A usage line
+ * is given without program name and usually starts with a command word,
+ * which is the key of the hash table, followed by:
+ *
+ *   word           command word
+ *   <arg>          positional argument, '[<arg>]' is optional
+ *   <arg>...       positional arguments till the end, the last one
+ *   -x, --name     flag
+ *   --name=<val>   option with value, as '--name=v' or '--name v'
+ *   --             end of options, which argv has anyway
+ *
+ * Options are required unless they are in brackets, e.g. '[--force]',
+ * and are taken in any position before '--'.  Lines without command
+ * word, e.g. '--version', are keyed by "".
+ */
+#define DOCOPT_MAXELEMS 32
+
+struct docopt_cmd;
+struct docopt_valued;
+
+/* Values of a matched command line, which point into argv */
+struct docopt_match {
+	const char *usage;             /* registered usage line */
+	const struct docopt_cmd *cmd;
+	int argc;
+	char **argv;
+	const char *vals[DOCOPT_MAXELEMS];
+	unsigned nums[DOCOPT_MAXELEMS];
+};
+
+typedef int (*docopt_handler)(const struct docopt_match *m, void *ctx);
+
+struct docopt_registry {
+	struct docopt_cmd **buckets;
+	unsigned nbuckets;             /* power of two or 0 */
+	unsigned num;
+	/* Options which some line takes with a value, by name */
+	struct docopt_valued **valued;
+	unsigned nvalued;              /* power of two or 0 */
+	unsigned valuednum;
+};
+
+/*
+ * Returns -EINVAL if the line is malformed, -EEXIST if the same line
+ * is registered and -ENOMEM.  Lines are copied.
+ */
+int docopt_register(struct docopt_registry *reg, const char *usage,
+		    docopt_handler handler, void *ctx);
+int docopt_unregister(struct docopt_registry *reg, const char *usage);
+void docopt_registryfree(struct docopt_registry *reg);
+
+/*
+ * Index of the command word of argv, the key of its lines, or 0: the
+ * first argument which does not start with '-' and is not the value of
+ * an option which some line of 'reg' takes as '--name=<val>'.
+ */
+int docopt_cmdword(const struct docopt_registry *reg, int argc, char **argv);
+
+/*
+ * Lines of the command word of argv are tried in the order of
+ * registration, the handler of the first matched one is called.  Lines
+ * without command word are tried next and count only if one matches.
+ * Returns 0 if no line has the word, 1 if a handler is called and its
+ * result is in 'status': 'argi' is the index of the command word, or 0
+ * for a line without one.  Returns -1 if no line matches: 'argi' is the
+ * argument where the line which went furthest failed, or 'argc' if
+ * something is missing.
+ */
+int docopt_dispatch(const struct docopt_registry *reg, int argc,
+		    char **argv, int *status, int *argi);
+
+/*
+ * Lines of one key only, "" for lines without command word, with the
+ * results of docopt_dispatch(), except that 'argi' is 0 on success.
+ * Generated parsers try their spec between the two keys.
+ */
+int docopt_dispatchkey(const struct docopt_registry *reg, const char *key,
+		       int argc, char **argv, int *status, int *argi);
+
+/*
+ * Registers each line of the 'Usage:' section of a docopt text, the
+ * program name is skipped.  Groups '(a|b)', '[a|b]' and '|' of a line
+ * are expanded into the lines above, e.g. 'mine (set|remove) <x>' into
+ * 'mine set <x>' and 'mine remove <x>', up to 256 per line.  Nothing
+ * is registered unless all lines are: returns the error of the first
+ * line which can't be, -EEXIST if a line is in 'reg' already or -E2BIG.
+ */
+int docopt_registerspec(struct docopt_registry *reg, const char *spec,
+			docopt_handler handler, void *ctx);
+
+/*
+ * Values by names of the usage line, e.g. '<arg>' or '--name': the
+ * value, the option itself for flags or NULL.  docopt_matchnum()
+ * returns how many times an element is given, docopt_matcharr()
+ * returns the i-th value of '<arg>...'.
+ */
+const char *docopt_matchstr(const struct docopt_match *m, const char *name);
+unsigned docopt_matchnum(const struct docopt_match *m, const char *name);
+const char *docopt_matcharr(const struct docopt_match *m, const char *name,
+			    unsigned i);
+
+/*
+ * Registry which is replaced while other threads dispatch, e.g. when
+ * commands of a daemon change with its configuration.  Dispatch takes
+ * no lock: readers are counted per epoch and a replaced registry is
+ * freed once readers of its epoch are gone.
+ *
+ * docopt_liveswap() takes the contents of 'reg', which is left empty,
+ * and waits for readers of the replaced one, so it must not be called
+ * from a handler.  Swaps are serialized.  docopt_livefree() must not
+ * race with dispatch.
+ */
+struct docopt_live;
+
+struct docopt_live *docopt_livenew(void);
+void docopt_livefree(struct docopt_live *live);
+int docopt_liveswap(struct docopt_live *live, struct docopt_registry *reg);
+int docopt_livedispatch(struct docopt_live *live, int argc, char **argv,
+			int *status, int *argi);
+
+#endif /* DOCOPT_RT_H */
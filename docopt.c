@@ -2,8 +2,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <ctype.h>
 #include <assert.h>
+#include <limits.h>
+#include <getopt.h>
 #include <linux/limits.h>
 
 #include "docopt.tab.h"
@@ -55,6 +58,7 @@ static void arg_init(struct arg *arg, struct cmd *cmd, unsigned type,
 	arg->type = type;
 	arg->flags = flags;
 	arg->name = name;
+	arg->grpid = -1;
 	arg->prev = NULL;
 	INIT_LIST_HEAD(&arg->args);
 }
@@ -170,6 +174,11 @@ static struct hashed_args *hargs_alloc(const struct arg *arg)
 
 	hargs->type = arg->type;
 	hargs->flags = arg->flags;
+	hargs->optid = -1;
+	hargs->bindid = -1;
+	hargs->bind = NULL;
+	hargs->env = NULL;
+	hargs->cmd = 0;
 
 	INIT_LIST_HEAD(&hargs->list);
 	hash_entry_init(&hargs->hentry, hargs->name, strlen(hargs->name));
@@ -179,6 +188,8 @@ static struct hashed_args *hargs_alloc(const struct arg *arg)
 
 static void hargs_free(struct hashed_args *hargs)
 {
+	free(hargs->bind);
+	free(hargs->env);
 	free(hargs->name);
 	free(hargs);
 }
@@ -198,6 +209,9 @@ static int ctx_hasharg(struct ctx *ctx, struct arg *arg)
 		found = hargs_alloc(arg);
 		if (found == NULL)
 			return -ENOMEM;
+		/* Options are matched by the scanner in any order */
+		if (arg->name[0] == '-')
+			found->optid = ctx->optsnum++;
 
 		list_add_tail(&arg->hlistent, &found->list);
 		hash_insert(&ctx->uniqargs, &found->hentry, &hint);
@@ -289,12 +303,35 @@ struct cmd *ctx_lastcmd(struct ctx *ctx)
 void ctx_init(struct ctx *ctx)
 {
 	strcpy(ctx->basename, "HEADER_IS_HERE");
+	ctx->in = NULL;
+	strcpy(ctx->prefix, "cli");
+	strcpy(ctx->yyprefix, "yy");
+	ctx->embed = false;
+	ctx->getopt = false;
+	ctx->runtime = false;
+	ctx->tagged = false;
+	ctx->image = false;
+	ctx->peek = false;
+	ctx->visit = false;
+	ctx->fuzz = false;
+	ctx->cachesize = 0;
 	ctx->yyaccout = stdout;
 	ctx->lexout = stdout;
 	ctx->hdrout = stdout;
+	ctx->cout = stdout;
 	ctx->interactive = false;
 	ctx->havearrays = false;
+	ctx->havetail = false;
+	ctx->bindpath = NULL;
+	ctx->bindtype[0] = '\0';
+	ctx->bindincl = NULL;
+	ctx->bindsnum = 0;
+	ctx->optnames = NULL;
+	ctx->optnamesnum = 0;
+	ctx->envsnum = 0;
 	ctx->cmdsnum = 0;
+	ctx->optsnum = 0;
+	ctx->grpsnum = 0;
 	INIT_LIST_HEAD(&ctx->cmds);
 	hash_init(&ctx->uniqargs);
 }
@@ -320,12 +357,22 @@ void ctx_freecmds(struct ctx *ctx)
 		hargs_free(hargs);
 	}
 	ctx->cmdsnum = 0;
+	ctx->optsnum = 0;
+	ctx->grpsnum = 0;
 	ctx->havearrays = false;
+	ctx->havetail = false;
+	ctx->bindtype[0] = '\0';
+	ctx->bindsnum = 0;
+	ctx->envsnum = 0;
 }
 
 void ctx_free(struct ctx *ctx)
 {
 	ctx_freecmds(ctx);
+	while (ctx->optnamesnum)
+		free(ctx->optnames[--ctx->optnamesnum]);
+	free(ctx->optnames);
+	free(ctx->bindincl);
 	if (ctx->in)
 		fclose(ctx->in);
 	if (ctx->yyaccout && ctx->yyaccout != stdout)
@@ -334,6 +381,8 @@ void ctx_free(struct ctx *ctx)
 		fclose(ctx->lexout);
 	if (ctx->hdrout && ctx->hdrout != stdout)
 		fclose(ctx->hdrout);
+	if (ctx->cout && ctx->cout != stdout)
+		fclose(ctx->cout);
 }
 
 static int print_strtoupper(FILE *out, const char *str)
@@ -364,6 +413,356 @@ static int print_strtolower(FILE *out, const char *str)
 	return cnt;
 }
 
+/*
+ * Prints a line of the template expanding placeholders: '@cli' is the
+ * prefix of public C symbols, '@yy' is the prefix of yacc & lex symbols,
+ * '@fn ' and '@var ' are linkage of functions and global variables,
+ * which are static for the embedded single translation unit.
+ */
+static void print_tmpl(struct ctx *ctx, FILE *out, const char *str)
+{
+	const struct {
+		const char *name;
+		const char *value;
+	} vars[] = {
+		{ "@cli",  ctx->prefix },
+		{ "@yy",   ctx->yyprefix },
+		{ "@fn ",  ctx->embed ? "static inline " : "" },
+		{ "@var ", ctx->embed ? "static " : "" },
+	};
+	const char *at;
+	int i;
+
+	while ((at = strchr(str, '@'))) {
+		fwrite(str, 1, at - str, out);
+		str = at;
+		for (i = 0; i < ARRAY_SIZE(vars); i++) {
+			size_t len = strlen(vars[i].name);
+
+			if (strncmp(str, vars[i].name, len))
+				continue;
+			fputs(vars[i].value, out);
+			str += len;
+			break;
+		}
+		if (str == at) {
+			fputc('@', out);
+			str++;
+		}
+	}
+	fprintf(out, "%s\n", str);
+}
+
+static void print_tmpls(struct ctx *ctx, FILE *out, const char **lines,
+			size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num; i++)
+		print_tmpl(ctx, out, lines[i]);
+}
+
+/*
+ * Generator has nothing to do without memory, so helpers below
+ * never return NULL.
+ */
+static void *xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (ptr == NULL) {
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+
+	return ptr;
+}
+
+static char *xasprintf(const char *fmt, ...)
+{
+	va_list ap;
+	char *str;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = vasprintf(&str, fmt, ap);
+	va_end(ap);
+	if (rc < 0) {
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+
+	return str;
+}
+
+static bool arg_isopt(struct arg *arg)
+{
+	return !arg_isgroup(arg) && arg->name[0] == '-';
+}
+
+static bool arg_haspos(struct arg *arg)
+{
+	struct arg *child;
+
+	if (!arg_isgroup(arg))
+		return !arg_isopt(arg);
+	list_for_each_entry(child, &arg->args, argsent) {
+		if (arg_haspos(child))
+			return true;
+	}
+
+	return false;
+}
+
+static int ctx_optid(struct ctx *ctx, const struct arg *arg)
+{
+	struct hash_entry *hent;
+	struct hashed_args *found;
+
+	hent = hash_lookup(&ctx->uniqargs, arg->name,
+			   strlen(arg->name), NULL);
+	assert(hent);
+	found = container_of(hent, typeof(*found), hentry);
+
+	return found->optid;
+}
+
+/*
+ * Positional tokens of the generated parser: 0 is the end of
+ * arguments, 1 is any word, others are commands in hash order.
+ */
+static unsigned ctx_ntoks(struct ctx *ctx)
+{
+	struct hashed_args *hargs;
+	unsigned ntoks = 2;
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type == T_FLAG && hargs->optid < 0)
+			ntoks += 1;
+	}
+
+	return ntoks;
+}
+
+/* The first usage line which has a part in the union or 0 */
+static unsigned ctx_firstpart(struct ctx *ctx)
+{
+	struct hashed_args *hargs;
+	unsigned first = 0;
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->cmd && (!first || hargs->cmd < first))
+			first = hargs->cmd;
+	}
+
+	return first;
+}
+
+static bool ctx_haspart(struct ctx *ctx, unsigned icmd)
+{
+	struct hashed_args *hargs;
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->cmd == icmd)
+			return true;
+	}
+
+	return false;
+}
+
+/* Member of 'struct cli', fields of one usage line are in the union */
+static int print_field(FILE *out, const struct hashed_args *hargs)
+{
+	int len = 0;
+
+	if (hargs->cmd)
+		len = fprintf(out, "cmd%u.", hargs->cmd);
+
+	return len + print_strtolower(out, hargs->name);
+}
+
+/* Fields of a usage line which is not matched read as zero */
+static void print_read(FILE *out, const struct hashed_args *hargs,
+		       const char *suffix)
+{
+	if (hargs->cmd)
+		fprintf(out, "(cli->_cmd == %u ? cli->", hargs->cmd);
+	else
+		fprintf(out, "cli->");
+	print_field(out, hargs);
+	fprintf(out, "%s%s", suffix, hargs->cmd ? " : 0)" : "");
+}
+
+/* Write into the union is skipped if another usage line has it */
+static void print_take(FILE *out, const struct hashed_args *hargs)
+{
+	if (hargs->cmd)
+		fprintf(out, "if (cli_take(cli, %u)) ", hargs->cmd);
+}
+
+/* Appends a value to an array or passes it to the visitor */
+static void print_strdup_arr(FILE *out, const struct hashed_args *hargs,
+			     const char *val)
+{
+	fprintf(out, "CLI_STRDUP_ARR(cli, ");
+	print_field(out, hargs);
+	fprintf(out, ", ");
+	print_strtolower(out, hargs->name);
+	fprintf(out, ", %s);", val);
+}
+
+static void hdr_dumperror(struct ctx *ctx)
+{
+	const char *kinds[] = {
+		"/* Kinds of parse errors, common for all generated parsers */",
+		"#ifndef CLI_ERR_NONE",
+		"#define CLI_ERR_NONE    0",
+		"#define CLI_ERR_NOMEM   1 /* allocation failed */",
+		"#define CLI_ERR_SYNTAX  2 /* argument is incorrect */",
+		"#define CLI_ERR_MISSING 3 /* argument or option value is missing */",
+		"#define CLI_ERR_OPTIONS 4 /* options do not match usage */",
+		"#define CLI_ERR_QUOTE   5 /* unterminated quote or escape */",
+		"#define CLI_ERR_AMBIGUOUS 6 /* abbreviation of several options */",
+		"#define CLI_ERR_VALUE   7 /* value does not fit the bound field */",
+		"#endif",
+		"",
+		"/*",
+		" * Details of a failed parse, see @cli_lasterror().  Expected",
+		" * tokens are a bit set: bit 0 is the end of arguments, bit 1 is",
+		" * any word, others are commands, see @cli_tokname().",
+		" */",
+		"struct @cli_error {",
+		"	int kind;",
+		"	int argi;                  /* index in argv or -1 */",
+		"	int cmd;                   /* usage line of the matched prefix or 0 */",
+	};
+	const char *footer[] = {
+		"};",
+		"",
+		"static inline int",
+		"@cli_expects(const struct @cli_error *err, unsigned tok)",
+		"{",
+		"	return tok / 8 < sizeof(err->expected) &&",
+		"		err->expected[tok / 8] & 1 << tok % 8;",
+		"}",
+		"",
+	};
+	FILE *out = ctx->hdrout;
+
+	print_tmpls(ctx, out, kinds, ARRAY_SIZE(kinds));
+	fprintf(out, "	unsigned char expected[%u];\n",
+		(ctx_ntoks(ctx) + 7) / 8);
+	print_tmpls(ctx, out, footer, ARRAY_SIZE(footer));
+}
+
+static void hdr_dumpfields(struct ctx *ctx)
+{
+	const char *header[] = {
+		"/* Kinds of fields in the field table, common for all parsers */",
+		"#ifndef CLI_FIELD_FLAG",
+		"#define CLI_FIELD_FLAG 0 /* unsigned */",
+		"#define CLI_FIELD_STR  1 /* char * */",
+		"#define CLI_FIELD_ARR  2 /* char ** with the number of strings */",
+		"#endif",
+		"",
+		"/*",
+		" * Fields of 'struct @cli' for generic iteration, the table is",
+		" * terminated by NULL name.",
+		" */",
+		"struct @cli_field {",
+		"	const char *name;",
+		"	int kind;",
+		"	size_t offset;",
+		"	size_t numoffset;          /* number of strings of an array */",
+	};
+	const char *table[] = {
+		"};",
+		"",
+		"static const struct @cli_field @cli_fields[] = {",
+	};
+	const char *footer1[] = {
+		"};",
+		"",
+		"/* Value of a flag, number of strings of an array or string */",
+		"static inline unsigned",
+		"@cli_field_num(const struct @cli *cli, const struct @cli_field *f)",
+		"{",
+		"	const char *ptr = (const char *)cli;",
+		"",
+	};
+	const char *footer2[] = {
+		"	if (f->kind == CLI_FIELD_FLAG)",
+		"		return *(const unsigned *)(ptr + f->offset);",
+		"	if (f->kind == CLI_FIELD_ARR)",
+		"		return *(const unsigned *)(ptr + f->numoffset);",
+		"",
+		"	return *(char *const *)(ptr + f->offset) != NULL;",
+		"}",
+		"",
+		"static inline const char *",
+		"@cli_field_str(const struct @cli *cli, const struct @cli_field *f,",
+		"		unsigned i)",
+		"{",
+		"	const char *ptr = (const char *)cli;",
+		"",
+	};
+	const char *footer3[] = {
+		"	if (f->kind == CLI_FIELD_ARR)",
+		"		return (*(char *const *const *)(ptr + f->offset))[i];",
+		"	if (f->kind == CLI_FIELD_STR)",
+		"		return *(char *const *)(ptr + f->offset);",
+		"",
+		"	return NULL;",
+		"}",
+		"",
+	};
+	FILE *out = ctx->hdrout;
+	struct hashed_args *hargs;
+
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
+	if (ctx->tagged)
+		fprintf(out, "	unsigned cmd;              /* usage line of a field in the union or 0 */\n");
+	print_tmpls(ctx, out, table, ARRAY_SIZE(table));
+
+	/* Order of the example output, not of the structure */
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		fprintf(out, "	{ \"");
+		print_strtolower(out, hargs->name);
+		if (hargs->type == T_FLAG) {
+			fprintf(out, "\", CLI_FIELD_FLAG, offsetof(struct %s, ",
+				ctx->prefix);
+			print_field(out, hargs);
+			fprintf(out, "), 0");
+		} else if (hargs->flags & F_ARR) {
+			fprintf(out, "_arr\", CLI_FIELD_ARR,\n");
+			fprintf(out, "	  offsetof(struct %s, ", ctx->prefix);
+			print_field(out, hargs);
+			fprintf(out, "_arr),\n");
+			fprintf(out, "	  offsetof(struct %s, ", ctx->prefix);
+			print_field(out, hargs);
+			fprintf(out, "_num)");
+		} else {
+			fprintf(out, "\", CLI_FIELD_STR, offsetof(struct %s, ",
+				ctx->prefix);
+			print_field(out, hargs);
+			fprintf(out, "), 0");
+		}
+		if (ctx->tagged)
+			fprintf(out, ", %u", hargs->cmd);
+		fprintf(out, " },\n");
+	}
+	fprintf(out, ctx->tagged ? "	{ NULL, 0, 0, 0, 0 },\n" :
+		"	{ NULL, 0, 0, 0 },\n");
+
+	/* Fields of other usage lines than the matched one are empty */
+	print_tmpls(ctx, out, footer1, ARRAY_SIZE(footer1));
+	if (ctx->tagged)
+		fprintf(out, "	if (f->cmd && f->cmd != cli->_cmd)\n\t\treturn 0;\n\n");
+	print_tmpls(ctx, out, footer2, ARRAY_SIZE(footer2));
+	if (ctx->tagged)
+		fprintf(out, "	if (f->cmd && f->cmd != cli->_cmd)\n\t\treturn NULL;\n\n");
+	print_tmpls(ctx, out, footer3, ARRAY_SIZE(footer3));
+}
+
 static void hdr_dumpusage(struct ctx *ctx)
 {
 	FILE *out = ctx->hdrout;
@@ -373,12 +772,12 @@ static void hdr_dumpusage(struct ctx *ctx)
 
 	if (ctx->interactive) {
 		fprintf(out, "/* TODO: extract interactive input from lex /*\n");
-		fprintf(out, "static const char * const cli_usage = ");
+		fprintf(out, "static const char * const %s_usage = ", ctx->prefix);
 		fprintf(out, "\"Usage: CMD\";\n");
 	} else {
 		(void)fseek(ctx->in, 0, SEEK_SET);
 
-		fprintf(out, "static const char * const cli_usage =");
+		fprintf(out, "static const char * const %s_usage =", ctx->prefix);
 		while ((read = getline(&line, &len, ctx->in)) != -1) {
 			nl = strchr(line, '\n');
 			if (nl)
@@ -390,220 +789,701 @@ static void hdr_dumpusage(struct ctx *ctx)
 	}
 }
 
-static void hdr_dump(struct ctx *ctx)
+/*
+ * Layout magic of the serialized image: differs for specs with
+ * different set of arguments, so image of one spec is not accepted
+ * by cli_view() of another one.
+ */
+static unsigned ctx_imagemagic(struct ctx *ctx)
+{
+	struct hashed_args *hargs;
+	unsigned magic = 0;
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		magic ^= jhash(hargs->name, strlen(hargs->name));
+		magic += hargs->type | (hargs->flags & F_ARR);
+		magic = magic << 5 | magic >> 27;
+	}
+
+	return magic;
+}
+
+static void hdr_dumpimage(struct ctx *ctx)
 {
 	const char *header[] = {
 		"/*",
-		" * This is common header for command line interface parser",
-		" * generated by docopt.c utility.",
+		" * Relocatable image of 'struct @cli', see @cli_serialize() and",
+		" * @cli_view().  Strings and arrays of strings are referenced by",
+		" * offsets from the beginning of the image, zero offset is NULL.",
 		" */",
-		"",
+		"struct @cli_image {",
+		"	uint32_t magic;",
+		"	uint32_t size;",
 	};
-	const char *body[] = {
+	const char *footer[] = {
+		"};",
+		"",
+		"static inline const char *",
+		"@cli_image_str(const struct @cli_image *img, uint32_t off)",
+		"{",
+		"	return off ? (const char *)img + off : NULL;",
+		"}",
 		"",
-		"int cli_parse(int argc, char **argv, struct cli *cli);",
-		"void cli_free(struct cli *cli);",
+		"static inline const char *",
+		"@cli_image_arrstr(const struct @cli_image *img, uint32_t arr, unsigned i)",
+		"{",
+		"	const uint32_t *offs = (const void *)((const char *)img + arr);",
+		"",
+		"	return @cli_image_str(img, offs[i]);",
+		"}",
 		"",
 	};
 	FILE *out = ctx->hdrout;
 	struct hashed_args *hargs;
-	int i;
 
-	for (i = 0; i < ARRAY_SIZE(header); i++)
-		fprintf(out, "%s\n", header[i]);
-
-	fprintf(out, "#ifndef __");
-	print_strtoupper(out, ctx->basename);
-	fprintf(out, "_H__\n");
-	fprintf(out, "#define __");
-	print_strtoupper(out, ctx->basename);
-	fprintf(out, "_H__\n");
-	fprintf(out, "\n");
-	fprintf(out, "struct cli {\n");
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
 
-	/*
-	 * Print C structure of CLI members
-	 */
 	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
 		if (hargs->type != T_STR)
 			continue;
 		if (hargs->flags & F_ARR) {
-			fprintf(out, "	char **");
+			fprintf(out, "	uint32_t ");
 			print_strtolower(out, hargs->name);
 			fprintf(out, "_arr;\n");
-			fprintf(out, "	unsigned ");
+			fprintf(out, "	uint32_t ");
 			print_strtolower(out, hargs->name);
 			fprintf(out, "_num;\n");
 		} else {
-			fprintf(out, "	char *");
+			fprintf(out, "	uint32_t ");
 			print_strtolower(out, hargs->name);
 			fprintf(out, ";\n");
 		}
 	}
 	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
 		if (hargs->type == T_FLAG) {
-			fprintf(out, "	unsigned ");
+			fprintf(out, "	uint32_t ");
 			print_strtolower(out, hargs->name);
 			fprintf(out, ";\n");
 		}
 	}
-	fprintf(out, "};\n\n");
-
-	hdr_dumpusage(ctx);
-
-	for (i = 0; i < ARRAY_SIZE(body); i++)
-		fprintf(out, "%s\n", body[i]);
 
-	fprintf(out, "#endif /* __");
-	print_strtoupper(out, ctx->basename);
-	fprintf(out, "_H__ */\n");
+	print_tmpls(ctx, out, footer, ARRAY_SIZE(footer));
 }
 
-static void lex_dumpheader(struct ctx *ctx)
+/*
+ * Callbacks of arrays, which are passed values as they are parsed,
+ * see print_strdup_arr().
+ */
+static void hdr_dumpvisitor(struct ctx *ctx)
 {
-	const char *header1[] = {
+	const char *header[] = {
 		"/*",
-		" * This is lex scanner for command line interface parser",
-		" * generated by docopt.c utility.",
+		" * Streaming of repeating arguments: values of an array with a",
+		" * callback are passed to it as they are parsed and the array",
+		" * stays empty, so memory does not grow with the number of",
+		" * values.  A value is valid during the call only.  Callback",
+		" * returns 0 or a negative error, which ends the parse.",
 		" */",
-		"",
-		"%{",
-	};
-	const char *header2[] = {
-		"",
-		"extern int yycurarg;",
-		"extern int yyargc;",
-		"extern char **yyargv;",
-		"",
-		"%}",
-		"",
-		"%option nounput",
-		"%option noinput",
-		"%option nodefault",
-		"",
-		"%%",
-		"",
-		" /* single character ops */",
-		"\"=\" { return yytext[0]; }",
-		""
+		"struct @cli_visitor {",
 	};
-	const char *header3[] = {
-                "[^ \\t\\n=]+  { yylval.str = yytext; return WORD; }",
-                "[ \\t]       { /* ignore whitespace */ }",
-                "\\n          { yyterminate(); }",
-		"",
-		"<<EOF>> {",
-		"	YY_BUFFER_STATE buf;",
-		"",
-		"	/* Just take another string from an argument array */",
+	const char *footer[] = {
+		"	void *ctx;",
+		"};",
 		"",
-		"	if (++yycurarg == yyargc)",
-		"		yyterminate();",
-		"",
-		"	yy_delete_buffer(YY_CURRENT_BUFFER);",
-		"	buf = yy_scan_string(yyargv[yycurarg]);",
-		"	if (buf == NULL)",
-		"		yyterminate();",
-		"	yy_switch_to_buffer(buf);",
-		"}",
-		"%%",
+		"@fn int @cli_parse_visit(int argc, char **argv, struct @cli *cli,",
+		"		    const struct @cli_visitor *visitor);",
 		"",
-		"int yywrap(void)",
-		"{",
-		"	/*",
-		"	 * With '%option noyywrap' flex can generate code which",
-		"	 * gcc does not like and complains with '\"yywrap\" redefined'.",
-		"	 */",
-		"	return 1;",
-		"}",
 	};
-	FILE *out = ctx->lexout;
+	FILE *out = ctx->hdrout;
 	struct hashed_args *hargs;
-	int i;
 
-	for (i = 0; i < ARRAY_SIZE(header1); i++)
-		fprintf(out, "%s\n", header1[i]);
-	fprintf(out, "#include \"%s.tab.h\"\n", ctx->basename);
-	for (i = 0; i < ARRAY_SIZE(header2); i++)
-		fprintf(out, "%s\n", header2[i]);
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_STR || !(hargs->flags & F_ARR))
+			continue;
+		fprintf(out, "	int (*");
+		print_strtolower(out, hargs->name);
+		fprintf(out, ")(void *ctx, const char *val);\n");
+	}
+	print_tmpls(ctx, out, footer, ARRAY_SIZE(footer));
+}
+
+/* C members of the arguments of a usage line or common ones */
+static void hdr_dumpmembers(struct ctx *ctx, unsigned icmd, const char *indent)
+{
+	FILE *out = ctx->hdrout;
+	struct hashed_args *hargs;
 
-	/*
-	 * Print patterns of terminal symbols (tokens)
-	 */
 	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
-		if (hargs->type == T_FLAG || hargs->flags & F_VAL) {
-			fprintf(out, "\"%s\" { return ", hargs->name);
-			print_strtoupper(out, hargs->name);
-			fprintf(out, "; }\n");
+		if (hargs->type != T_STR || hargs->cmd != icmd)
+			continue;
+		if (hargs->flags & F_ARR) {
+			fprintf(out, "%schar **", indent);
+			print_strtolower(out, hargs->name);
+			fprintf(out, "_arr;\n");
+			fprintf(out, "%sunsigned ", indent);
+			print_strtolower(out, hargs->name);
+			fprintf(out, "_num;\n");
+		} else {
+			fprintf(out, "%schar *", indent);
+			print_strtolower(out, hargs->name);
+			fprintf(out, ";\n");
+		}
+	}
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type == T_FLAG && hargs->cmd == icmd) {
+			fprintf(out, "%sunsigned ", indent);
+			print_strtolower(out, hargs->name);
+			fprintf(out, ";\n");
 		}
 	}
-	fprintf(out, "\n");
-
-	for (i = 0; i < ARRAY_SIZE(header3); i++)
-		fprintf(out, "%s\n", header3[i]);
 }
 
-static void lex_dump(struct ctx *ctx)
+/*
+ * Arguments which only one usage line has are in the part of that
+ * line, only the part of the matched line is cleared and filled.
+ */
+static void hdr_dumpunion(struct ctx *ctx)
 {
-	lex_dumpheader(ctx);
+	FILE *out = ctx->hdrout;
+	unsigned icmd;
+
+	fprintf(out, "	unsigned _cmd;             /* matched usage line, part of the union */\n");
+	fprintf(out, "	union {\n");
+	for (icmd = 1; icmd <= ctx->cmdsnum; icmd++) {
+		if (!ctx_haspart(ctx, icmd))
+			continue;
+		fprintf(out, "		struct {\n");
+		hdr_dumpmembers(ctx, icmd, "			");
+		fprintf(out, "		} cmd%u;\n", icmd);
+	}
+	fprintf(out, "	};\n");
 }
 
-static bool ctx_isarr(struct ctx *ctx, const struct arg *arg)
+static void hdr_dump(struct ctx *ctx)
 {
-	struct hash_entry *hent;
-	struct hashed_args *found;
+	const char *header[] = {
+		"/*",
+		" * This is common header for command line interface parser",
+		" * generated by docopt.c utility.",
+		" */",
+		"",
+	};
+	const char *includes[] = {
+		"#include <stddef.h>",
+		"#include <stdint.h>",
+		"",
+	};
+	const char *allocator[] = {
+		"/*",
+		" * Memory allocator used for all parse allocations: strings, arrays,",
+		" * scanner buffers and parser stack.  Allocator is remembered in",
+		" * 'struct @cli', so it must outlive the @cli_free() call.  Like",
+		" * free(3) the 'free' callback is expected to accept NULL.",
+		" */",
+		"struct @cli_allocator {",
+		"	void *(*alloc)(void *ctx, size_t size);",
+		"	void *(*realloc)(void *ctx, void *ptr, size_t size);",
+		"	void (*free)(void *ctx, void *ptr);",
+		"	void *ctx;",
+		"};",
+		"",
+	};
+	const char *body[] = {
+		"",
+		"@fn int @cli_parse(int argc, char **argv, struct @cli *cli);",
+		"@fn int @cli_parse_alloc(int argc, char **argv, struct @cli *cli,",
+		"		    const struct @cli_allocator *alloc);",
+		"@fn void @cli_free(struct @cli *cli);",
+		"",
+		"/*",
+		" * Matches argv without building results: nothing is allocated",
+		" * for values.  Returns the number of the matched usage line or",
+		" * the error of @cli_parse(), see @cli_lasterror().",
+		" */",
+		"@fn int @cli_validate(int argc, char **argv);",
+		"",
+		"/*",
+		" * Helpers over the field table: @cli_dump() formats all fields",
+		" * like snprintf() and returns the length of the whole text,",
+		" * @cli_compare() returns 0 if results are equal.",
+		" */",
+		"@fn size_t @cli_dump(const struct @cli *cli, char *buf, size_t size);",
+		"@fn int @cli_compare(const struct @cli *a, const struct @cli *b);",
+		"",
+	};
+	const char *parser[] = {
+		"/*",
+		" * Parses into caller provided storage: no heap allocations and",
+		" * no stdio.  Returns -ENOMEM if 'buf' is too small.  Strings of",
+		" * 'cli' point into 'buf', so @cli_free() is not required.",
+		" *",
+		" * It is not reentrant: the scanner and the parser keep their",
+		" * state in statics, as for @cli_parse().  Don't call it from a",
+		" * signal handler which may interrupt another parse or from two",
+		" * threads at once.",
+		" */",
+		"@fn int @cli_parse_into(int argc, char **argv, struct @cli *cli,",
+		"		   void *buf, size_t size);",
+		"",
+		"/*",
+		" * Push interface: arguments (without program name) are fed one",
+		" * by one as they arrive and each is parsed immediately.  Error of",
+		" * @cli_push_arg() ends the parse, otherwise @cli_push_end() ends",
+		" * it and returns the same result as @cli_parse().  A parse which",
+		" * is given up, e.g. when the peer goes away, is ended by",
+		" * @cli_push_abort(), which frees what is parsed so far.",
+		" */",
+		"@fn int @cli_push_begin(struct @cli *cli,",
+		"		   const struct @cli_allocator *alloc);",
+		"@fn int @cli_push_arg(struct @cli *cli, const char *arg);",
+		"@fn int @cli_push_end(struct @cli *cli);",
+		"@fn void @cli_push_abort(struct @cli *cli);",
+		"",
+		"/*",
+		" * Parses arguments (without program name) of a command line,",
+		" * which is split in place by shell rules: words are separated",
+		" * by whitespace, quotes and backslashes are removed.",
+		" */",
+		"@fn int @cli_parse_line(char *line, struct @cli *cli);",
+		"",
+	};
+	const char *peek[] = {
+		"/*",
+		" * Cheap check of arguments before parsing, nothing is allocated:",
+		" * returns the number of the only usage line argv can match, 0 if",
+		" * there are several of them or -1 if argv can't match any.",
+		" */",
+		"@fn int @cli_peek(int argc, char **argv);",
+		"",
+	};
+	const char *errors[] = {
+		"/*",
+		" * Parse functions never write to stdio, details of the last",
+		" * failed parse are kept until the next parse is started.",
+		" * Name of a token is NULL if it is out of range.",
+		" */",
+		"@fn const struct @cli_error *@cli_lasterror(void);",
+		"@fn const char *@cli_tokname(unsigned tok);",
+		"",
+	};
+	const char *image[] = {
+		"@fn size_t @cli_serialize(const struct @cli *cli, void *buf, size_t size);",
+		"@fn const struct @cli_image *@cli_view(const void *buf, size_t size);",
+		"",
+	};
+	const char *cache[] = {
+		"/*",
+		" * Memoized parse: results for recently seen arguments are kept",
+		" * in LRU cache and shared, so they must not be changed or freed.",
+		" * Result stays valid until it is evicted by other arguments or",
+		" * the cache is flushed.  NULL is returned if parse fails, see",
+		" * @cli_lasterror().  'argv_tail' of a shared result is NULL,",
+		" * arguments after '--' are the last 'argc_tail' ones of argv.",
+		" */",
+		"struct @cli_cachestats {",
+		"	unsigned long hits;",
+		"	unsigned long misses;",
+		"	unsigned long evictions;",
+		"	unsigned entries;",
+		"};",
+		"",
+		"@fn const struct @cli *@cli_parse_cached(int argc, char **argv);",
+		"@fn void @cli_cache_stats(struct @cli_cachestats *stats);",
+		"@fn void @cli_cache_flush(void);",
+		"",
+	};
+	const char *plugins[] = {
+		"/*",
+		" * Commands added at runtime, e.g. by plugins, see docopt-rt.h",
+		" * for the syntax of usage lines.  Words of the spec can't be",
+		" * registered.  @cli_dispatch() calls the handler of a matched",
+		" * registered line and returns 1 with its result in 'status',",
+		" * otherwise argv is parsed by @cli_parse().  Lines without",
+		" * command word are tried only if @cli_parse() fails.",
+		" */",
+		"@fn int @cli_register(const char *usage, docopt_handler handler,",
+		"		 void *ctx);",
+		"@fn int @cli_unregister(const char *usage);",
+		"@fn int @cli_dispatch(int argc, char **argv, struct @cli *cli,",
+		"		 int *status);",
+		"",
+	};
+	const char *bind[] = {
+		"/*",
+		" * Parses straight into fields of the struct given by --bind,",
+		" * values are converted to the types of the fields.  Fields which",
+		" * are not bound are dropped.  Bound strings are malloc(3)ed and",
+		" * owned by the caller.  If parse fails, strings written by it are",
+		" * freed and reset to NULL, other bound fields may be changed.",
+		" */",
+	};
+	FILE *out = ctx->hdrout;
 
-	hent = hash_lookup(&ctx->uniqargs, arg->name,
-			   strlen(arg->name), NULL);
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
+
+	fprintf(out, "#ifndef __");
+	print_strtoupper(out, ctx->basename);
+	fprintf(out, "_H__\n");
+	fprintf(out, "#define __");
+	print_strtoupper(out, ctx->basename);
+	fprintf(out, "_H__\n");
+	fprintf(out, "\n");
+
+	print_tmpls(ctx, out, includes, ARRAY_SIZE(includes));
+	/* Parsers of the runtime mode share the allocator of the runtime */
+	if (ctx->runtime) {
+		fprintf(out, "#include \"docopt-rt.h\"\n\n");
+		print_tmpl(ctx, out, "#define @cli_allocator docopt_allocator");
+		fprintf(out, "\n");
+	} else
+		print_tmpls(ctx, out, allocator, ARRAY_SIZE(allocator));
+
+	fprintf(out, "struct %s {\n", ctx->prefix);
+	hdr_dumpmembers(ctx, 0, "	");
+	if (ctx->havetail) {
+		fprintf(out, "	char **argv_tail;          /* arguments after '--' in argv */\n");
+		fprintf(out, "	int argc_tail;\n");
+	}
+	if (ctx->tagged)
+		hdr_dumpunion(ctx);
+	print_tmpl(ctx, out, "	const struct @cli_allocator *_alloc;");
+	fprintf(out, "};\n\n");
+
+	hdr_dumperror(ctx);
+	hdr_dumpfields(ctx);
+	if (ctx->image)
+		hdr_dumpimage(ctx);
+	hdr_dumpusage(ctx);
+
+	print_tmpls(ctx, out, body, ARRAY_SIZE(body));
+	if (ctx->havearrays && ctx->visit)
+		hdr_dumpvisitor(ctx);
+	/* getopt_long() backend has only argv parse */
+	if (!ctx->getopt)
+		print_tmpls(ctx, out, parser, ARRAY_SIZE(parser));
+	if (ctx->peek)
+		print_tmpls(ctx, out, peek, ARRAY_SIZE(peek));
+	print_tmpls(ctx, out, errors, ARRAY_SIZE(errors));
+	if (ctx->image)
+		print_tmpls(ctx, out, image, ARRAY_SIZE(image));
+	if (ctx->cachesize)
+		print_tmpls(ctx, out, cache, ARRAY_SIZE(cache));
+	if (ctx->runtime && !ctx->getopt)
+		print_tmpls(ctx, out, plugins, ARRAY_SIZE(plugins));
+	if (ctx->bindsnum) {
+		fprintf(out, "struct %s;\n\n", ctx->bindtype);
+		print_tmpls(ctx, out, bind, ARRAY_SIZE(bind));
+		print_tmpl(ctx, out, "@fn int @cli_parse_bind(int argc, char **argv,");
+		fprintf(out, "\t\t   struct %s *cfg);\n\n", ctx->bindtype);
+	}
+
+	fprintf(out, "#endif /* __");
+	print_strtoupper(out, ctx->basename);
+	fprintf(out, "_H__ */\n");
+}
+
+static void lex_dumpheader(struct ctx *ctx)
+{
+	const char *header1[] = {
+		"/*",
+		" * This is lex scanner for command line interface parser",
+		" * generated by docopt.c utility.",
+		" */",
+		"",
+		"%{",
+	};
+	const char *header2[] = {
+		"",
+		"extern int @yycurarg;",
+		"extern int @yyargc;",
+		"extern char **@yyargv;",
+		"extern const struct @cli_allocator *@yyallocator;",
+		"",
+		"@fn void @yyfatal(const char *msg) __attribute__((noreturn));",
+		"#define YY_FATAL_ERROR(msg) @yyfatal(msg)",
+		"#define YY_DECL @fn int yylex(struct @cli *cli)",
+		"",
+		"@fn void @yyoption(struct @cli *cli, int id);",
+		"@fn int @yyoptval(struct @cli *cli, const char *val);",
+		"@fn int @yylongopt(struct @cli *cli, const char *name);",
+		"@fn int @yyplain(int i);",
+		"@fn YY_BUFFER_STATE @yyscanarg(const char *arg);",
+		"",
+		"%}",
+		"",
+		"%option nounput",
+		"%option noinput",
+		"%option nodefault",
+		"%option noyyalloc noyyrealloc noyyfree",
+		"",
+		"%x OPTVAL",
+	};
+	const char *header3[] = {
+		"",
+		"%%",
+		"",
+		" /* single character ops */",
+		"\"=\" { return yytext[0]; }",
+		""
+	};
+	const char *tail[] = {
+		" /* arguments after '--' are passed through without scanning */",
+		"\"--\" {",
+		"	if (strcmp(@yyargv[@yycurarg], \"--\")) {",
+		"		@yylval.str = yytext;",
+		"		return WORD;",
+		"	}",
+		"	@yytail(cli);",
+		"	yyterminate();",
+		"}",
+		"",
+	};
+	const char *header4[] = {
+		" /* long option which is not matched exactly can be abbreviated */",
+		"\"--\"[^=]+ {",
+		"	switch (@yylongopt(cli, yytext)) {",
+		"	case 1:",
+		"		BEGIN(OPTVAL);",
+		"		break;",
+		"	case -1:",
+		"		@yylval.str = yytext;",
+		"		return WORD;",
+		"	case -2:",
+		"		yyterminate();",
+		"	}",
+		"}",
+		"",
+		" /* whitespace is a part of a word, arguments are already split */",
+		"[^=]+  { @yylval.str = yytext; return WORD; }",
+		"",
+		" /* value of an option, either after '=', maybe empty, or the next argument */",
+		"<OPTVAL>\"=\"[^=]* {",
+		"	BEGIN(INITIAL);",
+		"	if (@yyoptval(cli, yytext + 1))",
+		"		yyterminate();",
+		"}",
+		"<OPTVAL>[^=]+ {",
+		"	BEGIN(INITIAL);",
+		"	if (@yyoptval(cli, yytext))",
+		"		yyterminate();",
+		"}",
+		"",
+		"<<EOF>> {",
+		"	YY_BUFFER_STATE buf;",
+		"	int tok;",
+		"",
+		"	/*",
+		"	 * Just take another string from an argument array.  Words",
+		"	 * and values without '=' are known in advance and are not",
+		"	 * scanned, see @yyplain().",
+		"	 */",
+		"	for (;;) {",
+		"		if (++@yycurarg == @yyargc)",
+		"			yyterminate();",
+		"		tok = @yyplain(@yycurarg);",
+		"		if (tok == 0)",
+		"			break;",
+		"		if (YY_START == INITIAL) {",
+		"			@yylval.str = @yyargv[@yycurarg];",
+		"			return tok;",
+		"		}",
+		"		BEGIN(INITIAL);",
+		"		if (@yyoptval(cli, @yyargv[@yycurarg]))",
+		"			yyterminate();",
+		"	}",
+		"",
+		"	@yy_delete_buffer(YY_CURRENT_BUFFER);",
+		"	buf = @yyscanarg(@yyargv[@yycurarg]);",
+		"	if (buf == NULL)",
+		"		yyterminate();",
+		"	@yy_switch_to_buffer(buf);",
+		"}",
+		"%%",
+		"",
+		"int yywrap(void)",
+		"{",
+		"	/*",
+		"	 * With '%option noyywrap' flex can generate code which",
+		"	 * gcc does not like and complains with '\"yywrap\" redefined'.",
+		"	 */",
+		"	return 1;",
+		"}",
+		"",
+		"/*",
+		" * Scanner buffers are allocated by the same allocator as the",
+		" * parse results, see @cli_parse_alloc().  When an allocation",
+		" * fails, YY_FATAL_ERROR jumps out of yy_scan_string(), and blocks",
+		" * it has taken by then aren't reachable from the scanner yet: the",
+		" * string, the buffer and the buffer stack are kept till it returns.",
+		" */",
+		"static void *scanblocks[3];",
+		"static unsigned scannum;",
+		"static int scanning;",
+		"",
+		"void *yyalloc(yy_size_t size)",
+		"{",
+		"	void *ptr = @yyallocator->alloc(@yyallocator->ctx, size);",
+		"",
+		"	if (ptr && scanning && scannum < sizeof(scanblocks) / sizeof(scanblocks[0]))",
+		"		scanblocks[scannum++] = ptr;",
+		"",
+		"	return ptr;",
+		"}",
+		"",
+		"void *yyrealloc(void *ptr, yy_size_t size)",
+		"{",
+		"	return @yyallocator->realloc(@yyallocator->ctx, ptr, size);",
+		"}",
+		"",
+		"void yyfree(void *ptr)",
+		"{",
+		"	@yyallocator->free(@yyallocator->ctx, ptr);",
+		"}",
+		"",
+		"@fn YY_BUFFER_STATE @yyscanarg(const char *arg)",
+		"{",
+		"	YY_BUFFER_STATE buf;",
+		"",
+		"	scannum = 0;",
+		"	scanning = 1;",
+		"	buf = @yy_scan_string(arg);",
+		"	scanning = 0;",
+		"",
+		"	return buf;",
+		"}",
+		"",
+		"/* Frees the scanner, after a jump out of @yyscanarg() as well */",
+		"@fn void @yyscanfree(void)",
+		"{",
+		"	while (scanning && scannum)",
+		"		yyfree(scanblocks[--scannum]);",
+		"	scanning = 0;",
+		"	@yylex_destroy();",
+		"}",
+	};
+	FILE *out = ctx->lexout;
+	struct hashed_args *hargs;
+
+	print_tmpls(ctx, out, header1, ARRAY_SIZE(header1));
+	fprintf(out, "#include \"%s.tab.h\"\n", ctx->basename);
+	if (ctx->havetail)
+		print_tmpl(ctx, out, "@fn int @yytail(struct @cli *cli);");
+	print_tmpls(ctx, out, header2, ARRAY_SIZE(header2));
+	if (strcmp(ctx->yyprefix, "yy"))
+		fprintf(out, "%%option prefix=\"%s\"\n", ctx->yyprefix);
+	if (ctx->embed)
+		/* Included by the grammar, see yacc_dumpfooter() */
+		fprintf(out, "%%option outfile=\"%s.lex.c\"\n",
+			ctx->basename);
+	print_tmpls(ctx, out, header3, ARRAY_SIZE(header3));
+
+	/*
+	 * Print patterns of terminal symbols (tokens).  Options are
+	 * not tokens: the scanner marks them as seen in any position
+	 * and takes their values, see yacc_dumpoptions().
+	 */
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->optid >= 0) {
+			fprintf(out, "\"%s\" { %soption(cli, %d);%s }\n",
+				hargs->name, ctx->yyprefix, hargs->optid,
+				hargs->flags & F_VAL ? " BEGIN(OPTVAL);" : "");
+		} else if (hargs->type == T_FLAG) {
+			fprintf(out, "\"%s\" { return ", hargs->name);
+			print_strtoupper(out, hargs->name);
+			fprintf(out, "; }\n");
+		}
+	}
+	fprintf(out, "\n");
+
+	if (ctx->havetail)
+		print_tmpls(ctx, out, tail, ARRAY_SIZE(tail));
+	print_tmpls(ctx, out, header4, ARRAY_SIZE(header4));
+}
+
+static void lex_dump(struct ctx *ctx)
+{
+	lex_dumpheader(ctx);
+}
+
+static struct hashed_args *ctx_findarg(struct ctx *ctx, const char *name)
+{
+	struct hash_entry *hent;
+
+	hent = hash_lookup(&ctx->uniqargs, name, strlen(name), NULL);
 	if (hent == NULL)
-		return false;
+		return NULL;
 
-	found = container_of(hent, typeof(*found), hentry);
+	return container_of(hent, struct hashed_args, hentry);
+}
+
+static bool ctx_isarr(struct ctx *ctx, const struct arg *arg)
+{
+	struct hashed_args *found = ctx_findarg(ctx, arg->name);
 
-	return found->flags & F_ARR;
+	return found && found->flags & F_ARR;
 }
 
-static unsigned yacc_dumparg(struct ctx *ctx, struct arg *arg, unsigned refs)
+/*
+ * Prints setter of a field, which writes into the bound struct
+ * instead of 'struct cli' if the field is bound.  'val' is NULL
+ * for flags.  The caller takes the union, see yacc_dumpset().
+ */
+static void yacc_dumpstore(struct ctx *ctx, FILE *out,
+			   struct hashed_args *hargs, const char *val)
 {
-	FILE *out = ctx->yyaccout;
+	if (hargs->bind) {
+		fprintf(out, val ? "CLI_BIND_STR(cli, " : "CLI_BIND_FLAG(cli, ");
+		print_field(out, hargs);
+		fprintf(out, ", %d, %s", hargs->bindid, hargs->bind);
+		if (val)
+			fprintf(out, ", %s", val);
+		fprintf(out, ");");
+	} else if (val) {
+		fprintf(out, "CLI_STRDUP(cli, ");
+		print_field(out, hargs);
+		fprintf(out, ", %s);", val);
+	} else {
+		fprintf(out, "cli->");
+		print_field(out, hargs);
+		fprintf(out, " = 1;");
+	}
+}
+
+static void yacc_dumpset(struct ctx *ctx, FILE *out,
+			 struct hashed_args *hargs, const char *val)
+{
+	print_take(out, hargs);
+	yacc_dumpstore(ctx, out, hargs, val);
+}
+
+static unsigned yacc_dumparg(struct ctx *ctx, FILE *out, struct arg *arg,
+			     unsigned refs)
+{
+	char val[32];
 
 	if (arg_isgroup(arg))
 		fprintf(out, "%s", arg->name);
 	else if (arg->type == T_STR) {
-		bool arr;
-
 		/*
 		 * Arrays (repeating strings) are for the whole context,
-		 * not only for this command.  Also arguments with values
-		 * along with repeating strings require separate rules
-		 * (see yacc_dumprules()).
+		 * not only for this command, so they require separate
+		 * rules (see yacc_dumprules()).
 		 */
-		arr = ctx_isarr(ctx, arg);
-		if ((arg->flags & F_ARR) && (arg->flags & F_VAL)) {
-			/* Intermediate rule with '-arr' suffix to
-			   cover repeating strings with values */
-			print_strtolower(out, arg->name);
-			fprintf(out, "-arr");
-		} else if (arr || arg->flags & F_VAL) {
+		if (ctx_isarr(ctx, arg)) {
 			print_strtolower(out, arg->name);
 		} else {
 			refs += 1;
-			fprintf(out, "WORD[ref%u]", refs);
-			if (arr) {
-				fprintf(out, " { CLI_STRDUP_ARR(cli, ");
-				print_strtolower(out, arg->name);
-				fprintf(out, ", $<str>ref%u); }", refs);
-			} else {
-				fprintf(out, " { CLI_STRDUP(cli, ");
-				print_strtolower(out, arg->name);
-				fprintf(out, ", $<str>ref%u); }", refs);
-			}
+			snprintf(val, sizeof(val), "$<str>ref%u", refs);
+			fprintf(out, "WORD[ref%u] { ", refs);
+			yacc_dumpset(ctx, out, ctx_findarg(ctx, arg->name), val);
+			fprintf(out, " }");
 		}
 	} else {
 		print_strtoupper(out, arg->name);
-		fprintf(out, " { cli->");
-		print_strtolower(out, arg->name);
-		fprintf(out, " = 1; }");
+		fprintf(out, " { ");
+		yacc_dumpset(ctx, out, ctx_findarg(ctx, arg->name), NULL);
+		fprintf(out, " }");
 	}
 
 	return refs;
@@ -617,7 +1497,7 @@ static void yacc_dumptokens(struct ctx *ctx)
 	fprintf(out, "%%token <str> WORD");
 
 	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
-		if (hargs->type == T_FLAG || hargs->flags & F_VAL) {
+		if (hargs->type == T_FLAG && hargs->optid < 0) {
 			fprintf(out, " ");
 			print_strtoupper(out, hargs->name);
 		}
@@ -626,293 +1506,3750 @@ static void yacc_dumptokens(struct ctx *ctx)
 	fprintf(out, "\n");
 }
 
-static void yacc_dumpheader(struct ctx *ctx)
+/*
+ * Code which is common for the bison and getopt_long() backends
+ */
+static void code_dumpmacros(struct ctx *ctx, FILE *out)
 {
-	static const char *header1[] = {
+	static const char *macros[] = {
+		"#define CLI_ALLOC(ptr, size)					\\",
+		"	(ptr)->_alloc->alloc((ptr)->_alloc->ctx, size)",
+		"",
+		"#define CLI_REALLOC(ptr, mem, size)				\\",
+		"	(ptr)->_alloc->realloc((ptr)->_alloc->ctx, mem, size)",
+		"",
+		"#define CLI_FREE(ptr, mem)					\\",
+		"	(ptr)->_alloc->free((ptr)->_alloc->ctx, mem)",
+		"",
+	};
+	static const char *dup[] = {
+		"#define CLI_STRCOPY(ptr, member, str) ({			\\",
+		"	size_t len = strlen(str) + 1;				\\",
+		"								\\",
+		"	(ptr)->member = CLI_ALLOC(ptr, len);			\\",
+		"	if (!(ptr)->member)					\\",
+		"		return -ENOMEM;					\\",
+		"	memcpy((ptr)->member, str, len);			\\",
+		"});",
+		"",
 		"/*",
-		" * This is bison grammar for command line interface parser",
-		" * generated by docopt.c.",
+		" * Array capacity is implied by the number of elements: array",
+		" * is reallocated each time the number reaches a power of two.",
 		" */",
+		"#define CLI_STRCOPY_ARR(ptr, member, str) ({			\\",
+		"	char **arr = (ptr)->member ## _arr;			\\",
+		"	size_t len, num = (ptr)->member ## _num;		\\",
+		"								\\",
+		"	if ((num & (num - 1)) == 0) {				\\",
+		"		arr = CLI_REALLOC(ptr, arr, sizeof(*arr) *	\\",
+		"				  (num ? num * 2 : 1));		\\",
+		"		if (!arr)					\\",
+		"			return -ENOMEM;				\\",
+		"		(ptr)->member ## _arr = arr;			\\",
+		"	}							\\",
+		"	len = strlen(str) + 1;					\\",
+		"	arr[num] = CLI_ALLOC(ptr, len);				\\",
+		"	if (!arr[num])						\\",
+		"		return -ENOMEM;					\\",
+		"	memcpy(arr[num], str, len);				\\",
+		"	(ptr)->member ## _num += 1;				\\",
+		"});",
 		"",
-		"%{",
-		"#include <stdio.h>",
-		"#include <string.h>",
-		"#include <errno.h>",
+	};
+	static const char *validate[] = {
+		"/* Values are not copied while @cli_validate() matches argv */",
+		"static int validating;",
+		"",
+		"#define CLI_STRDUP(ptr, member, str) ({				\\",
+		"	if (!validating)					\\",
+		"		CLI_STRCOPY(ptr, member, str);			\\",
+		"});",
+		"",
+	};
+	static const char *visit[] = {
+		"/*",
+		" * Values of arrays with a callback of the visitor are passed to",
+		" * it instead of being collected, 'name' is the member of both.",
+		" */",
+		"static const struct @cli_visitor *visitor;",
+		"",
+		"#define CLI_STRDUP_ARR(ptr, member, name, str) ({		\\",
+		"	int rc;							\\",
+		"								\\",
+		"	if (!validating && visitor && visitor->name) {		\\",
+		"		rc = visitor->name(visitor->ctx, str);		\\",
+		"		if (rc)						\\",
+		"			return rc;				\\",
+		"	} else if (!validating)					\\",
+		"		CLI_STRCOPY_ARR(ptr, member, str);		\\",
+		"});",
+		"",
+	};
+	static const char *novisit[] = {
+		"#define CLI_STRDUP_ARR(ptr, member, name, str) ({		\\",
+		"	if (!validating)					\\",
+		"		CLI_STRCOPY_ARR(ptr, member, str);		\\",
+		"});",
+		"",
+	};
+	static const char *rtdup[] = {
+		"#if DOCOPT_RT_ABI != 1",
+		"#error \"parser is generated for ABI 1 of libdocopt-rt\"",
+		"#endif",
+		"",
+		"#define CLI_STRCOPY(ptr, member, str) ({			\\",
+		"	(ptr)->member = docopt_strdup((ptr)->_alloc, str);	\\",
+		"	if (!(ptr)->member)					\\",
+		"		return -ENOMEM;					\\",
+		"});",
+		"",
+		"#define CLI_STRCOPY_ARR(ptr, member, str) ({			\\",
+		"	if (docopt_strpush((ptr)->_alloc, &(ptr)->member ## _arr,	\\",
+		"			   &(ptr)->member ## _num, str))	\\",
+		"		return -ENOMEM;					\\",
+		"});",
+		"",
+	};
+
+	print_tmpls(ctx, out, macros, ARRAY_SIZE(macros));
+	if (ctx->runtime)
+		print_tmpls(ctx, out, rtdup, ARRAY_SIZE(rtdup));
+	else
+		print_tmpls(ctx, out, dup, ARRAY_SIZE(dup));
+	print_tmpls(ctx, out, validate, ARRAY_SIZE(validate));
+	if (ctx->havearrays && ctx->visit)
+		print_tmpls(ctx, out, visit, ARRAY_SIZE(visit));
+	else if (ctx->havearrays)
+		print_tmpls(ctx, out, novisit, ARRAY_SIZE(novisit));
+}
+
+static void code_dumpvisit(struct ctx *ctx, FILE *out)
+{
+	static const char *visit[] = {
+		"",
+		"@fn int @cli_parse_visit(int argc, char **argv, struct @cli *cli,",
+		"		    const struct @cli_visitor *v)",
+		"{",
+		"	int rc;",
+		"",
+		"	visitor = v;",
+		"	rc = @cli_parse(argc, argv, cli);",
+		"	visitor = NULL;",
+		"",
+		"	return rc;",
+		"}",
+	};
+
+	if (ctx->havearrays && ctx->visit)
+		print_tmpls(ctx, out, visit, ARRAY_SIZE(visit));
+}
+
+static void code_dumpstdalloc(struct ctx *ctx, FILE *out)
+{
+	static const char *stdalloc[] = {
+		"static void *cli_stdalloc(void *ctx, size_t size)",
+		"{",
+		"	return malloc(size);",
+		"}",
+		"",
+		"static void *cli_stdrealloc(void *ctx, void *ptr, size_t size)",
+		"{",
+		"	return realloc(ptr, size);",
+		"}",
+		"",
+		"static void cli_stdfree(void *ctx, void *ptr)",
+		"{",
+		"	free(ptr);",
+		"}",
+		"",
+		"static const struct @cli_allocator cli_stdallocator = {",
+		"	.alloc   = cli_stdalloc,",
+		"	.realloc = cli_stdrealloc,",
+		"	.free    = cli_stdfree,",
+		"};",
+		"",
+	};
+
+	if (ctx->runtime)
+		fprintf(out, "#define cli_stdallocator docopt_stdallocator\n\n");
+	else
+		print_tmpls(ctx, out, stdalloc, ARRAY_SIZE(stdalloc));
+}
+
+/* Helpers over the field table */
+static void code_dumpresults(struct ctx *ctx, FILE *out)
+{
+	static const char *free1[] = {
+		"@fn void @cli_free(struct @cli *cli)",
+		"{",
+		"	const struct @cli_field *f;",
+		"	unsigned i;",
+		"",
+		"	/* Zeroed by the caller and never parsed into */",
+		"	if (!cli->_alloc)",
+		"		return;",
+		"	for (f = @cli_fields; f->name; f++) {",
+	};
+	static const char *results[] = {
+		"			continue;",
+		"		for (i = 0; f->kind == CLI_FIELD_ARR &&",
+		"			    i < @cli_field_num(cli, f); i++)",
+		"			CLI_FREE(cli, (char *)@cli_field_str(cli, f, i));",
+		"		CLI_FREE(cli, *(void **)((char *)cli + f->offset));",
+		"	}",
+		"}",
+		"",
+		"#define CLI_DUMP(fmt, ...) ({					\\",
+		"	int n = snprintf(len < size ? buf + len : NULL,		\\",
+		"			 len < size ? size - len : 0,		\\",
+		"			 fmt, __VA_ARGS__);			\\",
+		"	len += n > 0 ? n : 0;					\\",
+		"})",
+		"",
+		"@fn size_t @cli_dump(const struct @cli *cli, char *buf, size_t size)",
+		"{",
+		"	const struct @cli_field *f;",
+		"	const char *str;",
+		"	size_t len = 0;",
+		"	unsigned i;",
+		"",
+		"	for (f = @cli_fields; f->name; f++) {",
+		"		if (f->kind == CLI_FIELD_FLAG) {",
+		"			CLI_DUMP(\"'%s' = '%u'\\n\", f->name,",
+		"				 @cli_field_num(cli, f));",
+		"		} else if (f->kind == CLI_FIELD_STR) {",
+		"			str = @cli_field_str(cli, f, 0);",
+		"			CLI_DUMP(\"'%s' = '%s'\\n\", f->name,",
+		"				 str ?: \"(null)\");",
+		"		} else {",
+		"			for (i = 0; i < @cli_field_num(cli, f); i++)",
+		"				CLI_DUMP(\"'%s[%u]' = '%s'\\n\", f->name, i,",
+		"					 @cli_field_str(cli, f, i));",
+		"		}",
+		"	}",
+		"",
+		"	return len;",
+		"}",
+		"",
+		"#undef CLI_DUMP",
+		"",
+		"@fn int @cli_compare(const struct @cli *a, const struct @cli *b)",
+		"{",
+		"	const struct @cli_field *f;",
+		"	unsigned i, na, nb;",
+		"	int rc;",
+		"",
+		"	for (f = @cli_fields; f->name; f++) {",
+		"		na = @cli_field_num(a, f);",
+		"		nb = @cli_field_num(b, f);",
+		"		if (na != nb)",
+		"			return na < nb ? -1 : 1;",
+		"		for (i = 0; f->kind != CLI_FIELD_FLAG && i < na; i++) {",
+		"			rc = strcmp(@cli_field_str(a, f, i),",
+		"				    @cli_field_str(b, f, i));",
+		"			if (rc)",
+		"				return rc;",
+		"		}",
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+	};
+
+	print_tmpls(ctx, out, free1, ARRAY_SIZE(free1));
+	/* Parts of other usage lines in the union are not written */
+	if (ctx->tagged)
+		fprintf(out, "		if (f->kind == CLI_FIELD_FLAG ||\n"
+			"		    (f->cmd && f->cmd != cli->_cmd))\n");
+	else
+		fprintf(out, "		if (f->kind == CLI_FIELD_FLAG)\n");
+	print_tmpls(ctx, out, results, ARRAY_SIZE(results));
+}
+
+static int envarg_cmp(const void *a, const void *b)
+{
+	const struct hashed_args *ha = *(const struct hashed_args **)a;
+	const struct hashed_args *hb = *(const struct hashed_args **)b;
+
+	return strcmp(ha->env, hb->env) ?: strcmp(ha->name, hb->name);
+}
+
+/*
+ * Options of '[env: NAME]' which are not given in argv are taken from
+ * the environment.  Names are sorted by the generator, so 'environ' is
+ * scanned once with a binary search instead of getenv() per option.
+ */
+static void code_dumpenv(struct ctx *ctx, FILE *out)
+{
+	const char *env[] = {
+		"extern char **environ;",
+		"",
+		"/* Option is taken from a variable only where usage allows it */",
+		"static int cli_envseen(int id)",
+		"{",
+		"	optseen[id / 8] |= 1 << id % 8;",
+		"	if (cli_optcheck())",
+		"		return 1;",
+		"	optseen[id / 8] &= ~(1 << id % 8);",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"/*",
+		" * Options which are not given in argv are taken from variables,",
+		" * the first one wins as with getenv().  Flags are set by values",
+		" * other than \"\" and \"0\".",
+		" */",
+		"static int cli_env(struct @cli *cli)",
+		"{",
+		"	const char *vals[sizeof(cli_envnames) / sizeof(cli_envnames[0])] = {};",
+		"	unsigned lo, hi, mid = 0, i;",
+		"	const char *val;",
+		"	char **envp;",
+		"	size_t len;",
+		"	int cmp;",
+		"",
+		"	for (envp = environ; envp && *envp; envp++) {",
+		"		len = strcspn(*envp, \"=\");",
+		"		if ((*envp)[len] != '=')",
+		"			continue;",
+		"		for (lo = 0, hi = sizeof(vals) / sizeof(vals[0]); lo < hi; ) {",
+		"			mid = (lo + hi) / 2;",
+		"			cmp = strncmp(*envp, cli_envnames[mid], len);",
+		"			if (cmp == 0 && cli_envnames[mid][len])",
+		"				cmp = -1;",
+		"			if (cmp == 0)",
+		"				break;",
+		"			if (cmp < 0)",
+		"				hi = mid;",
+		"			else",
+		"				lo = mid + 1;",
+		"		}",
+		"		if (lo < hi && vals[mid] == NULL)",
+		"			vals[mid] = *envp + len + 1;",
+		"	}",
+		"",
+		"	for (i = 0; i < sizeof(vals) / sizeof(vals[0]); i++) {",
+		"		val = vals[i];",
+		"		if (val == NULL)",
+		"			continue;",
+		"		switch (i) {",
+	};
+	const char *envend[] = {
+		"		}",
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+	};
+	const char *noenv[] = {
+		"/* No option has [env: NAME] */",
+		"static int cli_env(struct @cli *cli)",
+		"{",
+		"	return 0;",
+		"}",
+		"",
+	};
+	struct hashed_args *hargs, **args;
+	unsigned num = 0, i, j, k, name = 0;
+	bool flag;
+
+	if (!ctx->envsnum) {
+		print_tmpls(ctx, out, noenv, ARRAY_SIZE(noenv));
+		return;
+	}
+	args = xrealloc(NULL, sizeof(*args) * ctx->envsnum);
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->env)
+			args[num++] = hargs;
+	}
+	assert(num == ctx->envsnum);
+	qsort(args, num, sizeof(*args), envarg_cmp);
+
+	fprintf(out, "/* Variables of options, sorted for a binary search */\n");
+	fprintf(out, "static const char *const cli_envnames[] = {\n");
+	for (i = 0; i < num; i++) {
+		if (!i || strcmp(args[i - 1]->env, args[i]->env))
+			fprintf(out, "	\"%s\",\n", args[i]->env);
+	}
+	fprintf(out, "};\n\n");
+
+	print_tmpls(ctx, out, env, ARRAY_SIZE(env));
+	for (i = 0; i < num; i = j) {
+		/* Options of one variable, e.g. '-s' and '--speed' */
+		flag = false;
+		for (j = i; j < num && !strcmp(args[j]->env, args[i]->env); j++)
+			flag |= args[j]->type == T_FLAG;
+		fprintf(out, "		case %u:\n			if (", name++);
+		for (k = i; k < j; k++)
+			fprintf(out, "%sCLI_SEEN(%d)", k > i ? " || " : "",
+				args[k]->optid);
+		if (flag)
+			fprintf(out, " ||\n			    !*val || !strcmp(val, \"0\")");
+		fprintf(out, ")\n				break;\n");
+		/* The first one which fits usage, setters are blocks */
+		for (k = i; k < j; k++) {
+			hargs = args[k];
+			fprintf(out, "			%sif (cli_envseen(%d))%s\n				",
+				k > i ? "} else " : "", hargs->optid,
+				j - i > 1 ? " {" : "");
+			if (hargs->flags & F_ARR && hargs->flags & F_VAL) {
+				print_take(out, hargs);
+				print_strdup_arr(out, hargs, "val");
+			} else
+				yacc_dumpset(ctx, out, hargs,
+					     hargs->flags & F_VAL ? "val" : NULL);
+			fprintf(out, "\n");
+		}
+		if (j - i > 1)
+			fprintf(out, "			}\n");
+		fprintf(out, "			break;\n");
+	}
+	free(args);
+	print_tmpls(ctx, out, envend, ARRAY_SIZE(envend));
+}
+
+/*
+ * Fuzzing entry point, e.g. for libFuzzer or AFL++, which also looks
+ * for inputs whose parse cost grows faster than the input does.
+ */
+static void code_dumpfuzz(struct ctx *ctx, FILE *out)
+{
+	static const char *fuzz[] = {
+		"",
+		"#ifdef FUZZ_EXAMPLE",
+		"/*",
+		" * Input is split into arguments by NUL.  Besides crashes, inputs are",
+		" * checked for super-linear cost: instructions (CPU time if perf",
+		" * events are not allowed) and allocated bytes per byte of argv may",
+		" * be at most FUZZ_MAXRATIO times higher than for the first 1/FUZZ_SCALE",
+		" * of its arguments.",
+		" */",
+		"#include <time.h>",
+		"#ifdef __linux__",
+		"#include <unistd.h>",
+		"#include <sys/syscall.h>",
+		"#include <linux/perf_event.h>",
+		"#endif",
+		"",
+		"#define FUZZ_MAXARGS 4096",
+		"#define FUZZ_SCALE 8",
+		"#ifndef FUZZ_MAXRATIO",
+		"#define FUZZ_MAXRATIO 3",
+		"#endif",
+		"/* Constant costs dominate shorter inputs */",
+		"#ifndef FUZZ_MINLEN",
+		"#define FUZZ_MINLEN 256",
+		"#endif",
+		"",
+		"struct fuzz_cost {",
+		"	unsigned long long len;",
+		"	unsigned long long ops;",
+		"	unsigned long long bytes;",
+		"};",
+		"",
+		"static unsigned long long fuzz_bytes;",
+		"",
+		"static void *fuzz_alloc(void *ctx, size_t size)",
+		"{",
+		"	fuzz_bytes += size;",
+		"	return malloc(size);",
+		"}",
+		"",
+		"static void *fuzz_realloc(void *ctx, void *ptr, size_t size)",
+		"{",
+		"	/* Old block is copied, so it is a cost as well */",
+		"	fuzz_bytes += size;",
+		"	return realloc(ptr, size);",
+		"}",
+		"",
+		"static void fuzz_free(void *ctx, void *ptr)",
+		"{",
+		"	free(ptr);",
+		"}",
+		"",
+		"static const struct @cli_allocator fuzz_allocator = {",
+		"	.alloc   = fuzz_alloc,",
+		"	.realloc = fuzz_realloc,",
+		"	.free    = fuzz_free,",
+		"};",
+		"",
+		"static unsigned long long fuzz_ops(void)",
+		"{",
+		"	struct timespec ts;",
+		"#ifdef __linux__",
+		"	static int fd = -2;",
+		"	struct perf_event_attr attr = {",
+		"		.type           = PERF_TYPE_HARDWARE,",
+		"		.size           = sizeof(attr),",
+		"		.config         = PERF_COUNT_HW_INSTRUCTIONS,",
+		"		.exclude_kernel = 1,",
+		"		.exclude_hv     = 1,",
+		"	};",
+		"	unsigned long long cnt;",
+		"",
+		"	if (fd == -2)",
+		"		fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);",
+		"	if (fd >= 0 && read(fd, &cnt, sizeof(cnt)) == sizeof(cnt))",
+		"		return cnt;",
+		"#endif",
+		"	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);",
+		"",
+		"	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;",
+		"}",
+		"",
+		"/* The cheapest of a few parses, the counters are noisy */",
+		"static void fuzz_parse(int argc, char **argv, struct fuzz_cost *cost)",
+		"{",
+		"	unsigned long long ops;",
+		"	struct @cli cli;",
+		"	int i;",
+		"",
+		"	cost->len = 0;",
+		"	for (i = 1; i < argc; i++)",
+		"		cost->len += strlen(argv[i]) + 1;",
+		"	cost->ops = ~0ULL;",
+		"	for (i = 0; i < 3; i++) {",
+		"		fuzz_bytes = 0;",
+		"		ops = fuzz_ops();",
+		"		if (@cli_parse_alloc(argc, argv, &cli, &fuzz_allocator) == 0)",
+		"			@cli_free(&cli);",
+		"		ops = fuzz_ops() - ops;",
+		"		if (ops < cost->ops)",
+		"			cost->ops = ops;",
+		"		cost->bytes = fuzz_bytes;",
+		"	}",
+		"}",
+		"",
+		"/* Cost per byte of the whole argv is higher than of the head */",
+		"static int fuzz_superlinear(unsigned long long whole, unsigned long long wlen,",
+		"			    unsigned long long head, unsigned long long hlen)",
+		"{",
+		"	return whole * hlen > head * wlen * FUZZ_MAXRATIO;",
+		"}",
+		"",
+		"int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)",
+		"{",
+		"	static char *argv[FUZZ_MAXARGS + 1];",
+		"	struct fuzz_cost whole, head;",
+		"	int argc = 1;",
+		"	char *buf, *p;",
+		"",
+		"	buf = malloc(size + 1);",
+		"	if (buf == NULL)",
+		"		return 0;",
+		"	memcpy(buf, data, size);",
+		"	buf[size] = '\\0';",
+		"	argv[0] = \"fuzz\";",
+		"	for (p = buf; p < buf + size && argc <= FUZZ_MAXARGS; p += strlen(p) + 1)",
+		"		argv[argc++] = p;",
+		"",
+		"	fuzz_parse(argc, argv, &whole);",
+		"	if (whole.len >= FUZZ_MINLEN && argc > FUZZ_SCALE) {",
+		"		fuzz_parse((argc - 1) / FUZZ_SCALE + 1, argv, &head);",
+		"		if (fuzz_superlinear(whole.ops, whole.len, head.ops, head.len) ||",
+		"		    fuzz_superlinear(whole.bytes, whole.len, head.bytes, head.len)) {",
+		"			fprintf(stderr, \"super-linear parse: %llu bytes of argv: \"",
+		"				\"%llu ops, %llu allocated, first %llu bytes: \"",
+		"				\"%llu ops, %llu allocated\\n\", whole.len,",
+		"				whole.ops, whole.bytes, head.len, head.ops,",
+		"				head.bytes);",
+		"			abort();",
+		"		}",
+		"	}",
+		"	free(buf);",
+		"",
+		"	return 0;",
+		"}",
+		"#endif",
+	};
+
+	print_tmpls(ctx, out, fuzz, ARRAY_SIZE(fuzz));
+}
+
+static void code_dumpmain(struct ctx *ctx, FILE *out)
+{
+	static const char *main[] = {
+		"",
+		"#ifdef MAIN_EXAMPLE",
+		"int main(int argc, char **argv)",
+		"{",
+		"	struct @cli cli;",
+		"	const struct @cli_error *err;",
+		"	unsigned tok;",
+		"	size_t len;",
+		"	char *buf;",
+		"	int rc;",
+	};
+	static const char *parse[] = {
+		"",
+		"	rc = @cli_parse(argc, argv, &cli);",
+		"	if (rc) {",
+		"		err = @cli_lasterror();",
+		"		if (err->kind == CLI_ERR_SYNTAX && err->argi >= 0)",
+		"			fprintf(stderr, \"\\nError: %d parameter '%s' is incorrect\\n\",",
+		"				err->argi, argv[err->argi]);",
+		"		else if (err->kind == CLI_ERR_MISSING)",
+		"			fprintf(stderr, \"\\nError: required parameter is missing\\n\");",
+		"		else if (err->kind == CLI_ERR_AMBIGUOUS)",
+		"			fprintf(stderr, \"\\nError: %d parameter '%s' is ambiguous\\n\",",
+		"				err->argi, argv[err->argi]);",
+		"		else if (err->kind == CLI_ERR_OPTIONS)",
+		"			fprintf(stderr, \"\\nError: options do not match usage\\n\");",
+		"		else if (err->kind == CLI_ERR_NOMEM)",
+		"			fprintf(stderr, \"\\nError: out of memory\\n\");",
+		"		for (tok = 0; @cli_tokname(tok); tok++) {",
+		"			if (@cli_expects(err, tok))",
+		"				fprintf(stderr, \"  expected %s\\n\", @cli_tokname(tok));",
+		"		}",
+		"		fprintf(stderr, \"\\n%s\\n\", @cli_usage);",
+		"		return -1;",
+		"	}",
+	};
+	static const char *dump[] = {
+		"	/* All fields as an example */",
+		"	len = @cli_dump(&cli, NULL, 0) + 1;",
+		"	buf = malloc(len);",
+		"	if (buf) {",
+		"		@cli_dump(&cli, buf, len);",
+		"		fputs(buf, stdout);",
+		"		free(buf);",
+		"	}",
+		"	@cli_free(&cli);",
+		"",
+		"	return 0;",
+		"}",
+		"#endif",
+	};
+
+	print_tmpls(ctx, out, main, ARRAY_SIZE(main));
+	print_tmpls(ctx, out, parse, ARRAY_SIZE(parse));
+	print_tmpls(ctx, out, dump, ARRAY_SIZE(dump));
+	if (ctx->fuzz)
+		code_dumpfuzz(ctx, out);
+}
+
+static void yacc_dumpheader(struct ctx *ctx)
+{
+	static const char *header1[] = {
+		"/*",
+		" * This is bison grammar for command line interface parser",
+		" * generated by docopt.c.",
+		" */",
+		"",
+		"%{",
+		"#include <stdio.h>",
+		"#include <stdlib.h>",
+		"#include <string.h>",
+		"#include <errno.h>",
+		"#include <setjmp.h>",
+		"#include <limits.h>",
+		"#if defined(__AVX2__) || defined(__SSE2__)",
+		"#include <immintrin.h>",
+		"#endif",
+		"",
+	};
+	static const char *runtime[] = {
+		"#include \"docopt-rt.h\"",
+		"",
+		"#define @cli_allocator docopt_allocator",
+		"",
+	};
+	static const char *globals[] = {
+		"static int error;",
+		"static jmp_buf fatal;",
+		"",
+		"@var int @yyargc;",
+		"@var int @yycurarg;",
+		"@var char **@yyargv;",
+		"@var const struct @cli_allocator *@yyallocator;",
+		"",
+		"struct @cli;",
+		"",
+		"@fn int yylex(struct @cli *cli);",
+		"@fn void yyerror(struct @cli *cli, const char *err);",
+		"",
+		"typedef struct yy_buffer_state* YY_BUFFER_STATE;",
+		"void @yy_switch_to_buffer(YY_BUFFER_STATE buf);",
+		"void @yy_delete_buffer(YY_BUFFER_STATE buf);",
+		"@fn YY_BUFFER_STATE @yyscanarg(const char *arg);",
+		"@fn void @yyscanfree(void);",
+		"",
+		"/*",
+		" * Parser stack grows through the allocator as well.  Command",
+		" * lines are flat and arrays are left recursive, so a small",
+		" * initial stack is enough.",
+		" */",
+		"#define YYINITDEPTH 32",
+		"static void *cli_yymalloc(size_t size);",
+		"static void cli_yyfree(void *ptr);",
+		"#define YYMALLOC cli_yymalloc",
+		"#define YYFREE cli_yyfree",
+		"",
+	};
+	static const char *seen[] = {
+		"/*",
+		" * Options are taken by the scanner in any position and are",
+		" * marked as seen, the set is checked for the matched command",
+		" * alternative when the whole input is parsed.",
+		" */",
+		"#define CLI_SEEN(id) (optseen[(id) / 8] & (1 << (id) % 8))",
+		"",
+		"static int optpending;",
+		"static int optalt;",
+	};
+	static const char *bind[] = {
+		"",
+		"static int cli_bindstr(void *field, const char *str, int seen);",
+		"static int cli_bindint(void *field, const char *str, int seen);",
+		"static int cli_bindlong(void *field, const char *str, int seen);",
+		"static int cli_bindllong(void *field, const char *str, int seen);",
+		"static int cli_binduint(void *field, const char *str, int seen);",
+		"static int cli_bindulong(void *field, const char *str, int seen);",
+		"static int cli_bindullong(void *field, const char *str, int seen);",
+		"static int cli_binddouble(void *field, const char *str, int seen);",
+		"",
+		"#define CLI_BOUND(id) (bindseen[(id) / 8] & (1 << (id) % 8))",
+		"",
+		"#define CLI_BIND_FLAG(ptr, member, id, field) ({		\\",
+		"	if (bindcfg) {						\\",
+		"		bindseen[(id) / 8] |= 1 << (id) % 8;		\\",
+		"		bindcfg->field = 1;				\\",
+		"	} else							\\",
+		"		(ptr)->member = 1;				\\",
+		"})",
+		"",
+		"/* Value is converted by the type of the bound field */",
+		"#define CLI_BIND_STR(ptr, member, id, field, str) ({		\\",
+		"	if (bindcfg) {						\\",
+		"		int rc = _Generic(&bindcfg->field,		\\",
+		"			char **: cli_bindstr,			\\",
+		"			const char **: cli_bindstr,		\\",
+		"			int *: cli_bindint,			\\",
+		"			long *: cli_bindlong,			\\",
+		"			long long *: cli_bindllong,		\\",
+		"			unsigned *: cli_binduint,		\\",
+		"			unsigned long *: cli_bindulong,		\\",
+		"			unsigned long long *: cli_bindullong,	\\",
+		"			double *: cli_binddouble)		\\",
+		"			(&bindcfg->field, str, CLI_BOUND(id));	\\",
+		"		if (rc)						\\",
+		"			return rc;				\\",
+		"		bindseen[(id) / 8] |= 1 << (id) % 8;		\\",
+		"	} else							\\",
+		"		CLI_STRDUP(ptr, member, str);			\\",
+		"})",
+		"",
+	};
+	static const char *header2[] = {
+		"%}",
+		"%code requires {",
+	};
+	static const char *header3[] = {
+		"}",
+		"%parse-param { struct @cli *cli }",
+		"%lex-param { struct @cli *cli }",
+		"%union {",
+		"	const char *str;",
+		"}",
+		"%define parse.error custom",
+		"%define lr.default-reduction consistent",
+		"%define api.push-pull push",
+		"",
+		"%start commands",
+		"",
+	};
+	FILE *out = ctx->yyaccout;
+
+	print_tmpls(ctx, out, header1, ARRAY_SIZE(header1));
+	if (ctx->runtime)
+		print_tmpls(ctx, out, runtime, ARRAY_SIZE(runtime));
+	print_tmpls(ctx, out, globals, ARRAY_SIZE(globals));
+	code_dumpmacros(ctx, out);
+	print_tmpls(ctx, out, seen, ARRAY_SIZE(seen));
+	fprintf(out, "static unsigned char optseen[%u];\n",
+		ctx->optsnum / 8 + 1);
+	/* Reduced alternatives of groups, see expr_matchgrp() */
+	if (ctx->grpsnum)
+		fprintf(out, "static int grpalts[%u];\n", ctx->grpsnum);
+	if (ctx->tagged)
+		print_tmpl(ctx, out, "\nstatic int cli_take(struct @cli *cli, unsigned cmd);");
+	if (ctx->bindsnum) {
+		fprintf(out, "\n/* Fields bound by --bind are written into 'bindcfg' */\n");
+		fprintf(out, "%s", ctx->bindincl ?: "");
+		fprintf(out, "static struct %s *bindcfg;\n", ctx->bindtype);
+		fprintf(out, "static unsigned char bindseen[%u];\n",
+			(ctx->bindsnum + 7) / 8);
+		print_tmpls(ctx, out, bind, ARRAY_SIZE(bind));
+	}
+	print_tmpls(ctx, out, header2, ARRAY_SIZE(header2));
+	fprintf(out, "#include \"%s.h\"\n", ctx->basename);
+	print_tmpls(ctx, out, header3, ARRAY_SIZE(header3));
+	if (strcmp(ctx->yyprefix, "yy"))
+		fprintf(out, "%%define api.prefix {%s}\n\n", ctx->yyprefix);
+
+	yacc_dumptokens(ctx);
+}
+
+static void yacc_dumpimage(struct ctx *ctx)
+{
+	const char *helpers[] = {
+		"static size_t cli_image_strsz(const char *str)",
+		"{",
+		"	return str ? strlen(str) + 1 : 0;",
+		"}",
+		"",
+		"static uint32_t cli_image_putstr(char *base, size_t *off, const char *str)",
+		"{",
+		"	size_t pos = *off;",
+		"",
+		"	if (str == NULL)",
+		"		return 0;",
+		"	*off += cli_image_strsz(str);",
+		"	memcpy(base + pos, str, *off - pos);",
+		"",
+		"	return pos;",
+		"}",
+		"",
+		"/* String is terminated inside the image */",
+		"static int cli_image_okstr(const struct @cli_image *img, uint32_t off)",
+		"{",
+		"	if (off == 0)",
+		"		return 1;",
+		"	if (off < sizeof(*img) || off >= img->size)",
+		"		return 0;",
+		"",
+		"	return !!memchr((const char *)img + off, '\\0', img->size - off);",
+		"}",
+		"",
+		"/* Offsets are checked against the size before they are read */",
+		"static int cli_image_okarr(const struct @cli_image *img, uint32_t off,",
+		"			   uint32_t num)",
+		"{",
+		"	const uint32_t *offs;",
+		"	uint32_t i;",
+		"",
+		"	if (off == 0)",
+		"		return num == 0;",
+		"	if (off < sizeof(*img) || off >= img->size ||",
+		"	    off % sizeof(*offs) ||",
+		"	    num > (img->size - off) / sizeof(*offs))",
+		"		return 0;",
+		"	offs = (const void *)((const char *)img + off);",
+		"	for (i = 0; i < num; i++)",
+		"		if (!cli_image_okstr(img, offs[i]))",
+		"			return 0;",
+		"",
+		"	return 1;",
+		"}",
+		"",
+		"/*",
+		" * Packs 'cli' into a relocatable image, which consists of the",
+		" * 'struct @cli_image' header followed by arrays of string offsets",
+		" * and then by the strings.  Returns the size of the image, nothing",
+		" * is written if it exceeds 'size'.",
+		" */",
+		"@fn size_t @cli_serialize(const struct @cli *cli, void *buf, size_t size)",
+		"{",
+		"	struct @cli_image *img = buf;",
+		"	char *base = buf;",
+		"	uint32_t *offs;",
+		"	size_t off;",
+	};
+	const char *view[] = {
+		"",
+		"	return off;",
+		"}",
+		"",
+		"/*",
+		" * Validates the image in place and returns it, or NULL if the",
+		" * image is malformed.  Buffer must be 4-byte aligned.",
+		" */",
+		"@fn const struct @cli_image *@cli_view(const void *buf, size_t size)",
+		"{",
+		"	const struct @cli_image *img = buf;",
+		"",
+		"	if (size < sizeof(*img) || (uintptr_t)buf % sizeof(uint32_t))",
+		"		return NULL;",
+		"	if (img->magic != CLI_IMAGE_MAGIC || img->size > size ||",
+		"	    img->size < sizeof(*img))",
+		"		return NULL;",
+	};
+	const char *footer[] = {
+		"",
+		"	return img;",
+		"}",
+		"",
+	};
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+
+	fprintf(out, "#define CLI_IMAGE_MAGIC 0x%08xu\n\n", ctx_imagemagic(ctx));
+
+	print_tmpls(ctx, out, helpers, ARRAY_SIZE(helpers));
+	if (ctx->havearrays)
+		fprintf(out, "	unsigned i;\n");
+
+	/*
+	 * Size of the image: header, arrays of offsets, strings
+	 */
+	fprintf(out, "\n	off = sizeof(*img);\n");
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_STR)
+			continue;
+		if (hargs->flags & F_ARR) {
+			fprintf(out, "	off += sizeof(*offs) * ");
+			print_read(out, hargs, "_num");
+			fprintf(out, ";\n	for (i = 0; i < ");
+			print_read(out, hargs, "_num");
+			fprintf(out, "; i++)\n");
+			fprintf(out, "		off += cli_image_strsz(cli->");
+			print_field(out, hargs);
+			fprintf(out, "_arr[i]);\n");
+		} else {
+			fprintf(out, "	off += cli_image_strsz(");
+			print_read(out, hargs, "");
+			fprintf(out, ");\n");
+		}
+	}
+	fprintf(out, "	if (off > size)\n");
+	fprintf(out, "		return off;\n\n");
+	fprintf(out, "	img->magic = CLI_IMAGE_MAGIC;\n");
+	fprintf(out, "	img->size = off;\n");
+	fprintf(out, "	offs = (uint32_t *)(img + 1);\n");
+
+	/*
+	 * Arrays of offsets go first to keep them aligned
+	 */
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_STR || !(hargs->flags & F_ARR))
+			continue;
+		fprintf(out, "	img->");
+		print_strtolower(out, hargs->name);
+		fprintf(out, "_num = ");
+		print_read(out, hargs, "_num");
+		fprintf(out, ";\n	img->");
+		print_strtolower(out, hargs->name);
+		fprintf(out, "_arr = ");
+		print_read(out, hargs, "_num");
+		fprintf(out, " ? (char *)offs - base : 0;\n");
+		fprintf(out, "	offs += ");
+		print_read(out, hargs, "_num");
+		fprintf(out, ";\n");
+	}
+	fprintf(out, "	off = (char *)offs - base;\n");
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type == T_STR && hargs->flags & F_ARR) {
+			fprintf(out, "	offs = (uint32_t *)(base + img->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, "_arr);\n");
+			fprintf(out, "	for (i = 0; i < ");
+			print_read(out, hargs, "_num");
+			fprintf(out, "; i++)\n");
+			fprintf(out, "		offs[i] = cli_image_putstr(base, &off, cli->");
+			print_field(out, hargs);
+			fprintf(out, "_arr[i]);\n");
+		} else if (hargs->type == T_STR) {
+			fprintf(out, "	img->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, " = cli_image_putstr(base, &off, ");
+			print_read(out, hargs, "");
+			fprintf(out, ");\n");
+		} else {
+			fprintf(out, "	img->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, " = ");
+			print_read(out, hargs, "");
+			fprintf(out, ";\n");
+		}
+	}
+
+	print_tmpls(ctx, out, view, ARRAY_SIZE(view));
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_STR)
+			continue;
+		if (hargs->flags & F_ARR) {
+			fprintf(out, "	if (!cli_image_okarr(img, img->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, "_arr, img->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, "_num))\n");
+		} else {
+			fprintf(out, "	if (!cli_image_okstr(img, img->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, "))\n");
+		}
+		fprintf(out, "		return NULL;\n");
+	}
+
+	print_tmpls(ctx, out, footer, ARRAY_SIZE(footer));
+}
+
+struct longopt {
+	const char *name;          /* without leading dashes */
+	int id;
+};
+
+static int longopt_cmp(const void *a, const void *b)
+{
+	const struct longopt *la = a, *lb = b;
+
+	return strcmp(la->name, lb->name);
+}
+
+/*
+ * Trie of long options for abbreviations.  Nodes are numbered in
+ * breadth-first order, so children of a node are consecutive and
+ * a node keeps only the first child and characters of its edges.
+ * Each node is a range of sorted names with a common prefix.
+ */
+static void yacc_dumptrie(struct ctx *ctx)
+{
+	const char *lookup[] = {
+		"",
+		"/*",
+		" * Returns id of the option which name or the only one which",
+		" * prefix is given, -1 if there is no such option and -2 if",
+		" * prefix is ambiguous.  Lookup is linear in the length,",
+		" * cli_trienode() returns the node of the name or -1.",
+		" */",
+		"static int cli_trienode(const char *name, size_t len)",
+		"{",
+		"	unsigned node = 0, k;",
+		"	size_t i;",
+		"",
+		"	for (i = 0; i < len; i++) {",
+		"		for (k = 0; k < cli_trie[node].nkeys; k++) {",
+		"			if (cli_triekeys[cli_trie[node].keys + k] == name[i])",
+		"				break;",
+		"		}",
+		"		if (k == cli_trie[node].nkeys)",
+		"			return -1;",
+		"		node = cli_trie[node].child + k;",
+		"	}",
+		"",
+		"	return node;",
+		"}",
+		"",
+		"static int cli_longopt(const char *name, size_t len)",
+		"{",
+		"	int node = len ? cli_trienode(name, len) : -1;",
+		"",
+		"	if (node < 0)",
+		"		return -1;",
+		"	if (cli_trie[node].id >= 0)",
+		"		return cli_trie[node].id;",
+		"",
+		"	return cli_trie[node].uniq >= 0 ? cli_trie[node].uniq : -2;",
+		"}",
+		"",
+		"@fn int @yylongopt(struct @cli *cli, const char *name)",
+		"{",
+		"	int id = cli_longopt(name + 2, strlen(name + 2));",
+		"",
+		"	if (id == -2) {",
+		"		error = -1;",
+		"		lasterr.kind = CLI_ERR_AMBIGUOUS;",
+		"		lasterr.argi = argbase + @yycurarg;",
+		"	}",
+		"	if (id < 0)",
+		"		return id;",
+		"	@yyoption(cli, id);",
+		"",
+		"	return cli_optvalued[id];",
+		"}",
+		"",
+	};
+	unsigned nopts = 0, nnodes = 1, maxnodes = 1, nkeys = 0;
+	unsigned head, lo, hi, d, i, j, child, keys;
+	unsigned *qlo, *qhi, *qd;
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+	struct longopt *opts;
+	unsigned char *valued;
+	char *chars;
+	int id;
+
+	opts = xrealloc(NULL, (ctx->optsnum + 1) * sizeof(*opts));
+	valued = xrealloc(NULL, ctx->optsnum + 1);
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->optid < 0)
+			continue;
+		valued[hargs->optid] = !!(hargs->flags & F_VAL);
+		if (strncmp(hargs->name, "--", 2) || !hargs->name[2])
+			continue;
+		opts[nopts].name = hargs->name + 2;
+		opts[nopts].id = hargs->optid;
+		maxnodes += strlen(opts[nopts].name);
+		nopts += 1;
+	}
+	qsort(opts, nopts, sizeof(*opts), longopt_cmp);
+
+	fprintf(out, "/* Options which take a value */\n");
+	fprintf(out, "static const unsigned char cli_optvalued[] = {");
+	for (i = 0; i < ctx->optsnum; i++)
+		fprintf(out, " %u,", valued[i]);
+	fprintf(out, " 0 };\n\n");
+
+	fprintf(out, "static const struct {\n");
+	fprintf(out, "	unsigned keys;             /* edges in cli_triekeys */\n");
+	fprintf(out, "	unsigned nkeys;\n");
+	fprintf(out, "	unsigned child;            /* first child */\n");
+	fprintf(out, "	int id;                    /* option which ends here */\n");
+	fprintf(out, "	int uniq;                  /* the only option below */\n");
+	fprintf(out, "} cli_trie[] = {\n");
+
+	qlo = xrealloc(NULL, maxnodes * sizeof(*qlo));
+	qhi = xrealloc(NULL, maxnodes * sizeof(*qhi));
+	qd = xrealloc(NULL, maxnodes * sizeof(*qd));
+	chars = xrealloc(NULL, maxnodes);
+	qlo[0] = 0;
+	qhi[0] = nopts;
+	qd[0] = 0;
+	for (head = 0; head < nnodes; head++) {
+		lo = qlo[head];
+		hi = qhi[head];
+		d = qd[head];
+		id = -1;
+		i = lo;
+		/* Names are sorted, so the one which ends here is the first */
+		if (lo < hi && opts[lo].name[d] == '\0')
+			id = opts[i++].id;
+		keys = nkeys;
+		child = nnodes;
+		while (i < hi) {
+			for (j = i + 1; j < hi; j++) {
+				if (opts[j].name[d] != opts[i].name[d])
+					break;
+			}
+			chars[nkeys++] = opts[i].name[d];
+			qlo[nnodes] = i;
+			qhi[nnodes] = j;
+			qd[nnodes] = d + 1;
+			nnodes += 1;
+			i = j;
+		}
+		fprintf(out, "	{ %u, %u, %u, %d, %d },\n", keys,
+			nnodes - child, child, id,
+			hi - lo == 1 ? opts[lo].id : -1);
+	}
+	fprintf(out, "};\n\n");
+	fprintf(out, "static const char cli_triekeys[] = \"%.*s\";\n",
+		(int)nkeys, chars);
+
+	free(chars);
+	free(qd);
+	free(qhi);
+	free(qlo);
+	free(valued);
+	free(opts);
+
+	print_tmpls(ctx, out, lookup, ARRAY_SIZE(lookup));
+}
+
+/*
+ * Scanner calls @yyoption() for each option it matches, option with a
+ * value is pending until the scanner calls @yyoptval() with the value.
+ */
+static void yacc_dumpoptions(struct ctx *ctx)
+{
+	const char *option[] = {
+		"@fn void @yyoption(struct @cli *cli, int id)",
+		"{",
+		"	optseen[id / 8] |= 1 << id % 8;",
+		"	switch (id) {",
+	};
+	const char *optval[] = {
+		"	}",
+		"}",
+		"",
+		"static int cli_optval(struct @cli *cli, int id, const char *val)",
+		"{",
+		"	switch (id) {",
+	};
+	const char *optvalend[] = {
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"@fn int @yyoptval(struct @cli *cli, const char *val)",
+		"{",
+		"	int rc;",
+		"",
+		"	rc = cli_optval(cli, optpending, val);",
+		"	optpending = -1;",
+		"	if (rc)",
+		"		error = rc;",
+		"",
+		"	return rc;",
+		"}",
+		"",
+	};
+	const char *tail[] = {
+		"/*",
+		" * Arguments after '--' are not copied, the tail points into argv.",
+		" * Pushed arguments are not kept, so there '--' is an error.",
+		" */",
+		"@fn int @yytail(struct @cli *cli)",
+		"{",
+		"	if (argbase) {",
+		"		error = -1;",
+		"		lasterr.kind = CLI_ERR_SYNTAX;",
+		"		lasterr.argi = argbase + @yycurarg;",
+		"		return -1;",
+		"	}",
+		"	cli->argv_tail = @yyargv + @yycurarg + 1;",
+		"	cli->argc_tail = @yyargc - @yycurarg - 1;",
+		"",
+		"	return 0;",
+		"}",
+		"",
+	};
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+
+	print_tmpls(ctx, out, option, ARRAY_SIZE(option));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->optid < 0)
+			continue;
+		fprintf(out, "	case %d:\n", hargs->optid);
+		if (hargs->flags & F_VAL)
+			fprintf(out, "		optpending = id;\n");
+		else {
+			fprintf(out, "		");
+			yacc_dumpset(ctx, out, hargs, NULL);
+			fprintf(out, "\n");
+		}
+		fprintf(out, "		break;\n");
+	}
+	print_tmpls(ctx, out, optval, ARRAY_SIZE(optval));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->optid < 0 || !(hargs->flags & F_VAL))
+			continue;
+		fprintf(out, "	case %d:\n", hargs->optid);
+		if (hargs->cmd)
+			fprintf(out, "		if (!cli_take(cli, %u))\n\t\t\tbreak;\n",
+				hargs->cmd);
+		if (hargs->flags & F_ARR) {
+			fprintf(out, "		");
+			print_strdup_arr(out, hargs, "val");
+			fprintf(out, "\n");
+		} else {
+			/* The last one of repeating options wins */
+			fprintf(out, "		CLI_FREE(cli, cli->");
+			print_field(out, hargs);
+			fprintf(out, ");\n");
+			fprintf(out, "		");
+			yacc_dumpstore(ctx, out, hargs, "val");
+			fprintf(out, "\n");
+		}
+		fprintf(out, "		break;\n");
+	}
+	print_tmpls(ctx, out, optvalend, ARRAY_SIZE(optvalend));
+
+	yacc_dumptrie(ctx);
+	if (ctx->havetail)
+		print_tmpls(ctx, out, tail, ARRAY_SIZE(tail));
+}
+
+static bool args_havesep(struct list_head *args)
+{
+	struct arg *arg;
+
+	list_for_each_entry(arg, args, argsent) {
+		if (arg->flags & F_SEP)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Static analysis of usage lines for @cli_peek(): the range of number
+ * of arguments and the set of first positional tokens of a command.
+ * Token 0 is the end of arguments, 1 is any word, others are commands.
+ */
+#define ARITY_INF UINT_MAX
+
+static unsigned arity_add(unsigned a, unsigned b)
+{
+	return a > ARITY_INF - b ? ARITY_INF : a + b;
+}
+
+static void arg_arity(struct ctx *ctx, struct arg *arg,
+		      unsigned *min, unsigned *max);
+
+static void args_arity(struct ctx *ctx, struct list_head *args,
+		       bool optional, unsigned *min, unsigned *max)
+{
+	unsigned brmin = 0, brmax = 0, amin, amax, npos = 0;
+	bool first = true;
+	struct arg *arg;
+
+	*min = *max = 0;
+	list_for_each_entry(arg, args, argsent) {
+		arg_arity(ctx, arg, &amin, &amax);
+		brmin = arity_add(brmin, amin);
+		brmax = arity_add(brmax, amax);
+		npos += arg_haspos(arg);
+		if (arg->flags & F_SEP || list_is_last(&arg->argsent, args)) {
+			if (first || brmin < *min)
+				*min = brmin;
+			if (brmax > *max)
+				*max = brmax;
+			brmin = brmax = 0;
+			first = false;
+		}
+	}
+	if (optional) {
+		*min = 0;
+		/* Positionals of a group without '|' repeat, see yacc_dumpgrp() */
+		if (npos > 1 && !args_havesep(args))
+			*max = ARITY_INF;
+	}
+}
+
+static void arg_arity(struct ctx *ctx, struct arg *arg,
+		      unsigned *min, unsigned *max)
+{
+	if (arg_isgroup(arg)) {
+		args_arity(ctx, &arg->args, arg->type == T_OPTGRP, min, max);
+	} else if (arg_isopt(arg)) {
+		/* Value is either after '=' or the next argument */
+		*min = 1;
+		*max = arg->flags & F_VAL ? 2 : 1;
+	} else {
+		*min = 1;
+		*max = arg->type == T_STR && ctx_isarr(ctx, arg) ?
+			ARITY_INF : 1;
+	}
+}
+
+static unsigned ctx_peektok(struct ctx *ctx, const struct arg *arg)
+{
+	struct hashed_args *hargs;
+	unsigned tok = 2;
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_FLAG || hargs->optid >= 0)
+			continue;
+		if (!strcmp(hargs->name, arg->name))
+			return tok;
+		tok += 1;
+	}
+	assert(0);
+
+	return 0;
+}
+
+static bool arg_first(struct ctx *ctx, struct arg *arg,
+		      unsigned char *first);
+
+/* Returns true if args can have no positional tokens at all */
+static bool args_first(struct ctx *ctx, struct list_head *args,
+		       bool optional, unsigned char *first)
+{
+	bool each = optional && !args_havesep(args);
+	bool nullable = false, brnull = true;
+	struct arg *arg;
+
+	list_for_each_entry(arg, args, argsent) {
+		if ((brnull || each) && !arg_first(ctx, arg, first))
+			brnull = false;
+		if (arg->flags & F_SEP || list_is_last(&arg->argsent, args)) {
+			nullable |= brnull;
+			brnull = true;
+		}
+	}
+
+	return nullable || optional;
+}
+
+static bool arg_first(struct ctx *ctx, struct arg *arg,
+		      unsigned char *first)
+{
+	unsigned tok;
+
+	if (arg_isgroup(arg))
+		return args_first(ctx, &arg->args, arg->type == T_OPTGRP,
+				  first);
+	/* Options are taken in any position */
+	if (arg_isopt(arg))
+		return true;
+
+	tok = arg->type == T_STR ? 1 : ctx_peektok(ctx, arg);
+	first[tok / 8] |= 1 << tok % 8;
+
+	return false;
+}
+
+static int strswitch_cmp(const void *a, const void *b)
+{
+	const struct longopt *la = a, *lb = b;
+	size_t alen = strlen(la->name), blen = strlen(lb->name);
+
+	if (alen != blen)
+		return alen < blen ? -1 : 1;
+	if (la->name[alen - 1] != lb->name[blen - 1])
+		return la->name[alen - 1] < lb->name[blen - 1] ? -1 : 1;
+
+	return strcmp(la->name, lb->name);
+}
+
+/*
+ * Lookup of a string by a switch on its length and its last character,
+ * which tells apart words better than the first one, e.g. 'ship' and
+ * 'shoot'.  Each name of the case is compared by memcmp().
+ */
+static void print_strswitch(FILE *out, const char *fn, struct longopt *names,
+			    unsigned num, int miss)
+{
+	size_t len, prevlen = 0;
+	unsigned i, j;
+	char c;
+
+	qsort(names, num, sizeof(*names), strswitch_cmp);
+	fprintf(out, "%s(const char *str, size_t len)\n{\n", fn);
+	fprintf(out, "	switch (len) {\n");
+	for (i = 0; i < num; i = j) {
+		len = strlen(names[i].name);
+		c = names[i].name[len - 1];
+		if (len != prevlen) {
+			if (prevlen)
+				fprintf(out, "		}\n		break;\n");
+			fprintf(out, "	case %zu:\n", len);
+			fprintf(out, "		switch (str[%zu]) {\n", len - 1);
+			prevlen = len;
+		}
+		fprintf(out, "		case '%c':\n", c);
+		for (j = i; j < num && strlen(names[j].name) == len &&
+		     names[j].name[len - 1] == c; j++) {
+			fprintf(out, "			if (!memcmp(str, \"%s\", %zu))\n",
+				names[j].name, len);
+			fprintf(out, "				return %d;\n", names[j].id);
+		}
+		fprintf(out, "			break;\n");
+	}
+	if (prevlen)
+		fprintf(out, "		}\n		break;\n");
+	fprintf(out, "	}\n\n	return %d;\n}\n", miss);
+}
+
+static void yacc_dumppeek(struct ctx *ctx)
+{
+	const char *tokname[] = {
+		"",
+		"@fn const char *@cli_tokname(unsigned tok)",
+		"{",
+		"	if (tok == 0)",
+		"		return \"<end>\";",
+		"	if (tok == 1)",
+		"		return \"<word>\";",
+		"	if (tok - 2 < sizeof(cli_peekwords) / sizeof(cli_peekwords[0]) - 1)",
+		"		return cli_peekwords[tok - 2];",
+		"",
+		"	return NULL;",
+		"}",
+		"",
+	};
+	const char *peek[] = {
+		"",
+		"static unsigned cli_peektok(const char *arg)",
+		"{",
+		"	return cli_wordtok(arg, strlen(arg));",
+		"}",
+		"",
+		"/* Returns 1 if option takes the next argument, -1 if not option */",
+		"static int cli_peekopt(const char *arg)",
+		"{",
+		"	size_t len = strcspn(arg, \"=\");",
+		"	int id;",
+		"",
+		"	if (arg[0] != '-')",
+		"		return -1;",
+		"	/* Long options may be abbreviated */",
+		"	if (arg[1] == '-')",
+		"		id = cli_longopt(arg + 2, len - 2);",
+		"	else",
+		"		id = cli_shortopt(arg, len);",
+		"	if (id < 0)",
+		"		return -1;",
+		"",
+		"	return arg[len] == '=' ? 0 : cli_optvalued[id];",
+		"}",
+		"",
+		"@fn int @cli_peek(int argc, char **argv)",
+		"{",
+		"	unsigned n = 0, tok = 0, i;",
+		"	int val = 0, cmd = 0;",
+		"",
+		"	for (i = 1; i < (unsigned)argc; i++) {",
+		"		/* Arguments after '--' are not scanned */",
+		"		if (cli_peektail(argv[i]))",
+		"			break;",
+		"		/* Empty argument has no tokens */",
+		"		if (argv[i][0] == '\\0')",
+		"			continue;",
+		"		n += 1;",
+		"		if (tok)",
+		"			continue;",
+		"		if (val) {",
+		"			val = 0;",
+		"			continue;",
+		"		}",
+		"		val = cli_peekopt(argv[i]);",
+		"		if (val < 0) {",
+		"			val = 0;",
+		"			tok = cli_peektok(argv[i]);",
+		"		}",
+		"	}",
+		"	for (i = 0; i < sizeof(cli_peekcmds) / sizeof(cli_peekcmds[0]); i++) {",
+		"		if (n < cli_peekcmds[i].min || n > cli_peekcmds[i].max)",
+		"			continue;",
+		"		if (!(cli_peekcmds[i].first[tok / 8] & 1 << tok % 8))",
+		"			continue;",
+		"		if (cmd)",
+		"			return 0;",
+		"		cmd = i + 1;",
+		"	}",
+		"",
+		"	return cmd ?: -1;",
+		"}",
+		"",
+	};
+	unsigned ntoks = ctx_ntoks(ctx), min, max, i, nnames = 0;
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+	struct longopt *names;
+	unsigned char *first;
+	struct cmd *cmd;
+
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry)
+		nnames += 1;
+	names = xrealloc(NULL, (nnames + 1) * sizeof(*names));
+	nnames = 0;
+	fprintf(out, "static const char *const cli_peekwords[] = {\n");
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_FLAG || hargs->optid >= 0)
+			continue;
+		fprintf(out, "	\"%s\",\n", hargs->name);
+		names[nnames].name = hargs->name;
+		names[nnames].id = nnames + 2;
+		nnames += 1;
+	}
+	fprintf(out, "	NULL\n};\n\n");
+	fprintf(out, "/* Token of a command word, 1 for other words */\n");
+	print_strswitch(out, "static unsigned cli_wordtok", names, nnames, 1);
+
+	/* Long options are looked up in the trie */
+	nnames = 0;
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->optid < 0 || !strncmp(hargs->name, "--", 2))
+			continue;
+		names[nnames].name = hargs->name;
+		names[nnames].id = hargs->optid;
+		nnames += 1;
+	}
+	fprintf(out, "\n/* Id of an option with single dash or -1 */\n");
+	print_strswitch(out, "static int cli_shortopt", names, nnames, -1);
+	free(names);
+	print_tmpls(ctx, out, tokname, ARRAY_SIZE(tokname));
+
+	/* Registered lines are checked against first words as well */
+	if (!ctx->peek && !ctx->runtime)
+		return;
+	fprintf(out, "/* Number of arguments and first tokens of usage lines */\n");
+	fprintf(out, "static const struct {\n");
+	fprintf(out, "	unsigned min;\n");
+	fprintf(out, "	unsigned max;\n");
+	fprintf(out, "	unsigned char first[%u];\n", (ntoks + 7) / 8);
+	fprintf(out, "} cli_peekcmds[] = {\n");
+	first = xrealloc(NULL, (ntoks + 7) / 8);
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		struct arg *arg;
+
+		memset(first, 0, (ntoks + 7) / 8);
+		if (args_first(ctx, &cmd->args, false, first))
+			first[0] |= 1;
+		args_arity(ctx, &cmd->args, false, &min, &max);
+		/* Options can be repeated */
+		list_for_each_entry(arg, &cmd->rawargs, entry) {
+			if (arg_isopt(arg))
+				max = ARITY_INF;
+		}
+		if (max == ARITY_INF)
+			fprintf(out, "	{ %u, UINT_MAX, {", min);
+		else
+			fprintf(out, "	{ %u, %u, {", min, max);
+		for (i = 0; i < (ntoks + 7) / 8; i++)
+			fprintf(out, "%s0x%02x", i ? ", " : " ", first[i]);
+		fprintf(out, " } },\n");
+	}
+	free(first);
+	fprintf(out, "};\n");
+	if (!ctx->peek)
+		return;
+
+	fprintf(out, "\nstatic int cli_peektail(const char *arg)\n{\n");
+	fprintf(out, "	return %s;\n}\n",
+		ctx->havetail ? "!strcmp(arg, \"--\")" : "0");
+	print_tmpls(ctx, out, peek, ARRAY_SIZE(peek));
+}
+
+/*
+ * Arguments are classified in advance: length and '=' of each argument
+ * are found by one vector scan, so words and values without '=' are
+ * taken without running them through the scanner DFA.
+ */
+static void yacc_dumpclassify(struct ctx *ctx)
+{
+	const char *classify[] = {
+		"/* Classes of arguments, see cli_classify() */",
+		"enum {",
+		"	CLI_ARG_EMPTY,",
+		"	CLI_ARG_WORD,           /* positional argument without '=' */",
+		"	CLI_ARG_EQ,             /* positional argument with '=' */",
+		"	CLI_ARG_SHORT,          /* '-' and anything */",
+		"	CLI_ARG_LONG,           /* '--' and anything */",
+		"	CLI_ARG_DDASH,          /* bare '--' */",
+		"};",
+		"",
+		"struct cli_arg {",
+		"	unsigned len;",
+		"	unsigned eq;            /* offset of the first '=' or len */",
+		"	unsigned eqs;           /* number of '=' */",
+		"	unsigned char kind;",
+		"};",
+		"",
+		"#if defined(__AVX2__)",
+		"typedef __m256i cli_vec;",
+		"#define CLI_VECLOAD(p) _mm256_load_si256((const __m256i *)(p))",
+		"#define CLI_VECMASK(v, c) \\",
+		"	(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)))",
+		"#elif defined(__SSE2__)",
+		"typedef __m128i cli_vec;",
+		"#define CLI_VECLOAD(p) _mm_load_si128((const __m128i *)(p))",
+		"#define CLI_VECMASK(v, c) \\",
+		"	(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)))",
+		"#endif",
+		"",
+		"#ifdef CLI_VECMASK",
+		"/*",
+		" * NUL and '=' are found by comparing a whole vector at once.  Loads",
+		" * are aligned, so bytes after NUL are read but a page boundary is",
+		" * never crossed.",
+		" */",
+		"__attribute__((no_sanitize_address))",
+		"static void cli_scanarg(const char *arg, struct cli_arg *cls)",
+		"{",
+		"	const char *p = (const char *)((uintptr_t)arg & ~(uintptr_t)(sizeof(cli_vec) - 1));",
+		"	unsigned skip = arg - p, nul, eqm;",
+		"	cli_vec v;",
+		"",
+		"	cls->eq = UINT_MAX;",
+		"	cls->eqs = 0;",
+		"	for (;; p += sizeof(cli_vec), skip = 0) {",
+		"		v = CLI_VECLOAD(p);",
+		"		nul = CLI_VECMASK(v, 0) >> skip << skip;",
+		"		eqm = CLI_VECMASK(v, '=') >> skip << skip;",
+		"		/* '=' after NUL is garbage */",
+		"		if (nul)",
+		"			eqm &= (nul & -nul) - 1;",
+		"		if (eqm) {",
+		"			if (cls->eq == UINT_MAX)",
+		"				cls->eq = p - arg + __builtin_ctz(eqm);",
+		"			cls->eqs += __builtin_popcount(eqm);",
+		"		}",
+		"		if (nul)",
+		"			break;",
+		"	}",
+		"	cls->len = p - arg + __builtin_ctz(nul);",
+		"	if (cls->eq == UINT_MAX)",
+		"		cls->eq = cls->len;",
+		"}",
+		"#else",
+		"static void cli_scanarg(const char *arg, struct cli_arg *cls)",
+		"{",
+		"	const char *p;",
+		"",
+		"	cls->eq = strcspn(arg, \"=\");",
+		"	cls->eqs = 0;",
+		"	for (p = arg + cls->eq; *p; p++)",
+		"		cls->eqs += *p == '=';",
+		"	cls->len = p - arg;",
+		"}",
+		"#endif",
+		"",
+		"static void cli_classify(const char *arg, struct cli_arg *cls)",
+		"{",
+		"	cli_scanarg(arg, cls);",
+		"	if (cls->len == 0)",
+		"		cls->kind = CLI_ARG_EMPTY;",
+		"	else if (arg[0] != '-')",
+		"		cls->kind = cls->eqs ? CLI_ARG_EQ : CLI_ARG_WORD;",
+		"	else if (arg[1] != '-')",
+		"		cls->kind = CLI_ARG_SHORT;",
+		"	else if (arg[2] == '\\0')",
+		"		cls->kind = CLI_ARG_DDASH;",
+		"	else",
+		"		cls->kind = CLI_ARG_LONG;",
+		"}",
+		"",
+	};
+	const char *rtclassify[] = {
+		"#define CLI_ARG_EMPTY DOCOPT_ARG_EMPTY",
+		"#define CLI_ARG_WORD DOCOPT_ARG_WORD",
+		"#define CLI_ARG_EQ DOCOPT_ARG_EQ",
+		"#define CLI_ARG_SHORT DOCOPT_ARG_SHORT",
+		"#define CLI_ARG_LONG DOCOPT_ARG_LONG",
+		"#define CLI_ARG_DDASH DOCOPT_ARG_DDASH",
+		"#define cli_arg docopt_arg",
+		"#define cli_classify docopt_classify",
+		"",
+	};
+	const char *window[] = {
+		"/*",
+		" * Window of classified arguments: argv is classified in one pass",
+		" * per window, so long command lines need no allocation.",
+		" */",
+		"#define CLI_ARGWIN 64",
+		"",
+		"static struct cli_arg argwin[CLI_ARGWIN];",
+		"static int argwinbase;",
+		"static int argwinnum;",
+		"",
+		"/* Arguments are read in a row, each window is classified once */",
+		"static const struct cli_arg *cli_argclass(int argc, char **argv, int i)",
+		"{",
+		"	int k;",
+		"",
+		"	if (i < argwinbase || i >= argwinbase + argwinnum) {",
+		"		argwinbase = i;",
+		"		argwinnum = argc - i < CLI_ARGWIN ? argc - i : CLI_ARGWIN;",
+		"		for (k = 0; k < argwinnum; k++)",
+		"			cli_classify(argv[i + k], &argwin[k]);",
+		"	}",
+		"",
+		"	return &argwin[i - argwinbase];",
+		"}",
+		"",
+		"/*",
+		" * Token of a word which the scanner would return as a whole or 0,",
+		" * see <<EOF>> rule of the scanner.",
+		" */",
+		"@fn int @yyplain(int i)",
+		"{",
+		"	const struct cli_arg *cls = cli_argclass(@yyargc, @yyargv, i);",
+		"",
+		"	if (cls->kind != CLI_ARG_WORD)",
+		"		return 0;",
+		"",
+		"	return cli_wordtoks[cli_wordtok(@yyargv[i], cls->len) - 1];",
+		"}",
+	};
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+
+	/* Same order as cli_peekwords[] */
+	fprintf(out, "\nstatic const int cli_wordtoks[] = {\n	WORD,\n");
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_FLAG || hargs->optid >= 0)
+			continue;
+		fprintf(out, "	");
+		print_strtoupper(out, hargs->name);
+		fprintf(out, ",\n");
+	}
+	fprintf(out, "};\n\n");
+	if (ctx->runtime)
+		print_tmpls(ctx, out, rtclassify, ARRAY_SIZE(rtclassify));
+	else
+		print_tmpls(ctx, out, classify, ARRAY_SIZE(classify));
+	print_tmpls(ctx, out, window, ARRAY_SIZE(window));
+}
+
+/* Leading positional tokens of a command, which are matched first */
+static unsigned cmd_prefix(struct ctx *ctx, struct cmd *cmd, FILE *out)
+{
+	struct arg *arg;
+	unsigned len = 0;
+
+	/* Alternatives of a whole command have no common prefix */
+	if (args_havesep(&cmd->args))
+		return 0;
+
+	list_for_each_entry(arg, &cmd->args, argsent) {
+		if (arg_isopt(arg))
+			continue;
+		if (arg_isgroup(arg))
+			break;
+		if (out && arg->type == T_STR)
+			fprintf(out, "WORD, ");
+		else if (out) {
+			print_strtoupper(out, arg->name);
+			fprintf(out, ", ");
+		}
+		len += 1;
+		if (arg->type == T_STR && ctx_isarr(ctx, arg))
+			break;
+	}
+
+	return len;
+}
+
+static void yacc_dumperror(struct ctx *ctx)
+{
+	const char *header[] = {
+		"",
+		"/* Details of the last failed parse, see @cli_lasterror() */",
+		"static struct @cli_error lasterr;",
+		"static int argbase;",
+		"",
+		"/*",
+		" * Leading positional tokens of usage lines, which are compared",
+		" * with the first tokens of the input to find the usage line of",
+		" * a failed parse.",
+		" */",
+	};
+	const char *track[] = {
+		"static unsigned prefixlen;",
+		"",
+		"static void cli_track(int tok)",
+		"{",
+		"	if (tok && prefixlen < sizeof(prefix) / sizeof(prefix[0]))",
+		"		prefix[prefixlen++] = tok;",
+		"}",
+		"",
+		"/* Usage line with the longest matched prefix or 0 */",
+		"static int cli_errcmd(void)",
+		"{",
+		"	unsigned i, j, best = 0;",
+		"	int cmd = 0;",
+		"",
+		"	for (i = 0; i < sizeof(cli_prefixes) / sizeof(cli_prefixes[0]); i++) {",
+		"		for (j = 0; j < prefixlen && cli_prefixes[i][j] == prefix[j]; j++)",
+		"			;",
+		"		if (j > best) {",
+		"			best = j;",
+		"			cmd = i + 1;",
+		"		} else if (j == best)",
+		"			cmd = 0;",
+		"	}",
+		"",
+		"	return cmd;",
+		"}",
+		"",
+		"static unsigned cli_tokclass(yysymbol_kind_t kind)",
+		"{",
+		"	switch (kind) {",
+		"	case YYSYMBOL_WORD:",
+		"		return 1;",
+	};
+	const char *report[] = {
+		"	default:",
+		"		return 0;",
+		"	}",
+		"}",
+		"",
+		"static int yyreport_syntax_error(const yypcontext_t *yyctx,",
+		"				 struct @cli *cli)",
+		"{",
+		"	yysymbol_kind_t expected[YYNTOKENS];",
+		"	unsigned tok;",
+		"	int i, n;",
+		"",
+		"	/* Allocation failure of the scanner is already set */",
+		"	if (error)",
+		"		return 0;",
+		"	error = -1;",
+		"	if (yypcontext_token(yyctx) == YYSYMBOL_YYEOF)",
+		"		lasterr.kind = CLI_ERR_MISSING;",
+		"	else",
+		"		lasterr.kind = CLI_ERR_SYNTAX;",
+		"	lasterr.argi = argbase + @yycurarg;",
+		"	n = yypcontext_expected_tokens(yyctx, expected, YYNTOKENS);",
+		"	for (i = 0; i < n; i++) {",
+		"		tok = cli_tokclass(expected[i]);",
+		"		lasterr.expected[tok / 8] |= 1 << tok % 8;",
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"/* Syntax errors are reported above, only stack exhaustion is left */",
+		"@fn void yyerror(struct @cli *cli, const char *errstr)",
+		"{",
+		"}",
+		"",
+		"@fn const struct @cli_error *@cli_lasterror(void)",
+		"{",
+		"	return &lasterr;",
+		"}",
+	};
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+	unsigned maxlen = 0, len, tok = 2;
+	struct cmd *cmd;
+
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
+
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		len = cmd_prefix(ctx, cmd, NULL);
+		if (len > maxlen)
+			maxlen = len;
+	}
+	/* Zero terminated, so never empty */
+	fprintf(out, "static const int cli_prefixes[][%u] = {\n", maxlen + 1);
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		fprintf(out, "	{ ");
+		cmd_prefix(ctx, cmd, out);
+		fprintf(out, "0 },\n");
+	}
+	fprintf(out, "};\n");
+	fprintf(out, "static int prefix[%u];\n", maxlen + 1);
+
+	print_tmpls(ctx, out, track, ARRAY_SIZE(track));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->type != T_FLAG || hargs->optid >= 0)
+			continue;
+		fprintf(out, "	case YYSYMBOL_");
+		print_strtoupper(out, hargs->name);
+		fprintf(out, ":\n		return %u;\n", tok++);
+	}
+	print_tmpls(ctx, out, report, ARRAY_SIZE(report));
+}
+
+static void yacc_dumpcache(struct ctx *ctx)
+{
+	const char *env[] = {
+		"#define CLI_CACHE_ENVS (sizeof(cli_envnames) / sizeof(cli_envnames[0]))",
+		"",
+		"/* Same values as cli_env() takes, the first one of each name */",
+		"static void cli_cacheenv(const char **envs)",
+		"{",
+		"	unsigned i;",
+		"",
+		"	for (i = 0; i < CLI_CACHE_ENVS; i++)",
+		"		envs[i] = getenv(cli_envnames[i]);",
+		"}",
+	};
+	const char *noenv[] = {
+		"#define CLI_CACHE_ENVS 0u",
+		"",
+		"static void cli_cacheenv(const char **envs)",
+		"{",
+		"	(void)envs;",
+		"}",
+	};
+	const char *cache[] = {
+		"",
+		"/*",
+		" * Parse results are kept in a fixed array of entries, which are",
+		" * chained in hash buckets and linked in the order of use.  Index",
+		" * 0 is a list terminator, so entries start from 1.",
+		" */",
+		"struct cli_cacheent {",
+		"	struct @cli cli;",
+		"	uint64_t hash;",
+		"	char *key;                 /* arguments and variables, see below */",
+		"	size_t keylen;",
+		"	int argc;",
+		"	unsigned hnext;            /* next entry in the bucket */",
+		"	unsigned prev;             /* more recently used entry */",
+		"	unsigned next;             /* less recently used entry */",
+		"};",
+		"",
+		"static struct cli_cacheent cache[CLI_CACHE_SIZE + 1];",
+		"static unsigned cachebuckets[CLI_CACHE_BUCKETS];",
+		"static unsigned cachehead, cachetail, cacheused;",
+		"static struct @cli_cachestats cachestats;",
+		"",
+		"/*",
+		" * Key is the arguments without the program name, each with its",
+		" * terminating NUL, and then a part of each variable: \"\" if it",
+		" * is not set or '=' with the value.",
+		" */",
+		"static uint64_t cli_cachehash(int argc, char **argv,",
+		"			      const char **envs, size_t *len)",
+		"{",
+		"	uint64_t hash = 0xcbf29ce484222325ull;",
+		"	const unsigned char *p;",
+		"	unsigned i;",
+		"",
+		"	*len = 0;",
+		"	for (i = 1; i < (unsigned)argc + CLI_CACHE_ENVS; i++) {",
+		"		if (i < (unsigned)argc)",
+		"			p = (const unsigned char *)argv[i];",
+		"		else if (envs[i - argc] == NULL)",
+		"			p = (const unsigned char *)\"\";",
+		"		else {",
+		"			hash = (hash ^ '=') * 0x100000001b3ull;",
+		"			*len += 1;",
+		"			p = (const unsigned char *)envs[i - argc];",
+		"		}",
+		"		do {",
+		"			hash = (hash ^ *p) * 0x100000001b3ull;",
+		"			*len += 1;",
+		"		} while (*p++);",
+		"	}",
+		"",
+		"	return hash;",
+		"}",
+		"",
+		"static int cli_cachematch(struct cli_cacheent *ent, int argc,",
+		"			  char **argv, const char **envs,",
+		"			  uint64_t hash, size_t len)",
+		"{",
+		"	const char *key = ent->key;",
+		"	unsigned i;",
+		"	size_t n;",
+		"",
+		"	if (ent->hash != hash || ent->keylen != len || ent->argc != argc)",
+		"		return 0;",
+		"	for (i = 1; i < (unsigned)argc; i++) {",
+		"		n = strlen(argv[i]) + 1;",
+		"		if (memcmp(key, argv[i], n))",
+		"			return 0;",
+		"		key += n;",
+		"	}",
+		"	for (i = 0; i < CLI_CACHE_ENVS; i++) {",
+		"		if (envs[i] == NULL) {",
+		"			if (*key++)",
+		"				return 0;",
+		"			continue;",
+		"		}",
+		"		n = strlen(envs[i]) + 1;",
+		"		if (*key++ != '=' || memcmp(key, envs[i], n))",
+		"			return 0;",
+		"		key += n;",
+		"	}",
+		"",
+		"	return 1;",
+		"}",
+		"",
+		"static void cli_cacheunlink(unsigned i)",
+		"{",
+		"	struct cli_cacheent *ent = &cache[i];",
+		"",
+		"	if (ent->prev)",
+		"		cache[ent->prev].next = ent->next;",
+		"	else",
+		"		cachehead = ent->next;",
+		"	if (ent->next)",
+		"		cache[ent->next].prev = ent->prev;",
+		"	else",
+		"		cachetail = ent->prev;",
+		"}",
+		"",
+		"static void cli_cachepush(unsigned i)",
+		"{",
+		"	struct cli_cacheent *ent = &cache[i];",
+		"",
+		"	ent->prev = 0;",
+		"	ent->next = cachehead;",
+		"	if (cachehead)",
+		"		cache[cachehead].prev = i;",
+		"	else",
+		"		cachetail = i;",
+		"	cachehead = i;",
+		"}",
+		"",
+		"static void cli_cacheremove(unsigned i)",
+		"{",
+		"	struct cli_cacheent *ent = &cache[i];",
+		"	unsigned *p;",
+		"",
+		"	p = &cachebuckets[ent->hash & (CLI_CACHE_BUCKETS - 1)];",
+		"	while (*p != i)",
+		"		p = &cache[*p].hnext;",
+		"	*p = ent->hnext;",
+		"	cli_cacheunlink(i);",
+		"	@cli_free(&ent->cli);",
+		"	free(ent->key);",
+		"}",
+		"",
+		"@fn const struct @cli *@cli_parse_cached(int argc, char **argv)",
+		"{",
+		"	const char *envs[CLI_CACHE_ENVS + 1];",
+		"	struct cli_cacheent *ent;",
+		"	struct @cli cli;",
+		"	unsigned i, *bucket;",
+		"	uint64_t hash;",
+		"	size_t len, n;",
+		"	char *key;",
+		"	int rc, j;",
+		"",
+		"	cli_cacheenv(envs);",
+		"	hash = cli_cachehash(argc, argv, envs, &len);",
+		"	bucket = &cachebuckets[hash & (CLI_CACHE_BUCKETS - 1)];",
+		"	for (i = *bucket; i; i = cache[i].hnext) {",
+		"		if (cli_cachematch(&cache[i], argc, argv, envs, hash, len)) {",
+		"			cachestats.hits++;",
+		"			cli_cacheunlink(i);",
+		"			cli_cachepush(i);",
+		"			return &cache[i].cli;",
+		"		}",
+		"	}",
+		"	cachestats.misses++;",
+		"",
+		"	/* Failed parses are not cached */",
+		"	rc = @cli_parse(argc, argv, &cli);",
+		"	if (rc)",
+		"		return NULL;",
+		"	key = malloc(len ?: 1);",
+		"	if (key == NULL) {",
+		"		@cli_free(&cli);",
+		"		lasterr.kind = CLI_ERR_NOMEM;",
+		"		return NULL;",
+		"	}",
+		"	for (j = 1, len = 0; j < argc; j++, len += n) {",
+		"		n = strlen(argv[j]) + 1;",
+		"		memcpy(key + len, argv[j], n);",
+		"	}",
+		"	for (j = 0; j < CLI_CACHE_ENVS; j++, len += n) {",
+		"		if (envs[j] == NULL) {",
+		"			key[len] = '\\0';",
+		"			n = 1;",
+		"			continue;",
+		"		}",
+		"		key[len++] = '=';",
+		"		n = strlen(envs[j]) + 1;",
+		"		memcpy(key + len, envs[j], n);",
+		"	}",
+		"",
+		"	if (cacheused < CLI_CACHE_SIZE)",
+		"		i = ++cacheused;",
+		"	else {",
+		"		i = cachetail;",
+		"		cli_cacheremove(i);",
+		"		cachestats.evictions++;",
+		"	}",
+		"	ent = &cache[i];",
+		"	ent->cli = cli;",
+	};
+	const char *cached[] = {
+		"	ent->hash = hash;",
+		"	ent->key = key;",
+		"	ent->keylen = len;",
+		"	ent->argc = argc;",
+		"	ent->hnext = *bucket;",
+		"	*bucket = i;",
+		"	cli_cachepush(i);",
+		"",
+		"	return &ent->cli;",
+		"}",
+		"",
+		"@fn void @cli_cache_stats(struct @cli_cachestats *stats)",
+		"{",
+		"	*stats = cachestats;",
+		"	stats->entries = cacheused;",
+		"}",
+		"",
+		"@fn void @cli_cache_flush(void)",
+		"{",
+		"	while (cachehead)",
+		"		cli_cacheremove(cachehead);",
+		"	cacheused = 0;",
+		"}",
+	};
+	FILE *out = ctx->yyaccout;
+	unsigned buckets = 1;
+
+	/* Load factor of buckets is at most 1/2 */
+	while (buckets < 2 * ctx->cachesize)
+		buckets <<= 1;
+	fprintf(out, "\n#define CLI_CACHE_SIZE %u\n", ctx->cachesize);
+	fprintf(out, "#define CLI_CACHE_BUCKETS %u\n", buckets);
+	/* Results depend on variables of '[env: NAME]' options as well */
+	if (ctx->envsnum)
+		print_tmpls(ctx, out, env, ARRAY_SIZE(env));
+	else
+		print_tmpls(ctx, out, noenv, ARRAY_SIZE(noenv));
+	print_tmpls(ctx, out, cache, ARRAY_SIZE(cache));
+	/* Shared entries don't keep pointers into argv of the first call */
+	if (ctx->havetail)
+		fprintf(out, "	ent->cli.argv_tail = NULL;\n");
+	print_tmpls(ctx, out, cached, ARRAY_SIZE(cached));
+}
+
+/*
+ * Registered lines are matched by the runtime before the grammar,
+ * the bucket is found by the command word of argv.
+ */
+static void yacc_dumpplugins(struct ctx *ctx)
+{
+	const char *plugins[] = {
+		"",
+		"static struct docopt_registry cli_registry;",
+		"",
+		"/* Word of the spec which starts some usage line */",
+		"static int cli_isfirstword(const char *word, size_t len)",
+		"{",
+		"	unsigned i, tok;",
+		"",
+		"	tok = cli_wordtok(word, len);",
+		"	if (tok == 1)",
+		"		return 0;",
+		"	for (i = 0; i < sizeof(cli_peekcmds) / sizeof(cli_peekcmds[0]); i++) {",
+		"		if (cli_peekcmds[i].first[tok / 8] & 1 << tok % 8)",
+		"			return 1;",
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"@fn int @cli_register(const char *usage, docopt_handler handler,",
+		"		 void *ctx)",
+		"{",
+		"	const char *word = usage + strspn(usage, \" \\t\\n\");",
+		"",
+		"	if (cli_isfirstword(word, strcspn(word, \" \\t\\n\")))",
+		"		return -EEXIST;",
+		"",
+		"	return docopt_register(&cli_registry, usage, handler, ctx);",
+		"}",
+		"",
+		"@fn int @cli_unregister(const char *usage)",
+		"{",
+		"	int rc = docopt_unregister(&cli_registry, usage);",
+		"",
+		"	if (!cli_registry.num)",
+		"		docopt_registryfree(&cli_registry);",
+		"",
+		"	return rc;",
+		"}",
+		"",
+		"@fn int @cli_dispatch(int argc, char **argv, struct @cli *cli,",
+		"		 int *status)",
+		"{",
+		"	int rc = 0, argi, i;",
+		"",
+		"	i = docopt_cmdword(&cli_registry, argc, argv);",
+		"	if (i && argv[i][0])",
+		"		rc = docopt_dispatchkey(&cli_registry, argv[i], argc, argv,",
+		"					status, &argi);",
+		"	/* Lines without command word don't take command lines of the spec */",
+		"	if (rc == 0) {",
+		"		rc = @cli_parse(argc, argv, cli);",
+		"		if (rc != -1 || docopt_dispatchkey(&cli_registry, \"\", argc,",
+		"						   argv, status, &i) <= 0)",
+		"			return rc;",
+		"		rc = 1;",
+		"	} else if (rc < 0 && docopt_dispatchkey(&cli_registry, \"\", argc,",
+		"						argv, status, &i) > 0)",
+		"		rc = 1;",
+		"	/* Nothing of the spec is set */",
+		"	memset(cli, 0, sizeof(*cli));",
+		"	cli->_alloc = &cli_stdallocator;",
+		"	if (rc > 0)",
+		"		return 1;",
+		"	memset(&lasterr, 0, sizeof(lasterr));",
+		"	lasterr.kind = argi == argc ? CLI_ERR_MISSING : CLI_ERR_SYNTAX;",
+		"	lasterr.argi = argi;",
+		"",
+		"	return -1;",
+		"}",
+	};
+	FILE *out = ctx->yyaccout;
+
+	print_tmpls(ctx, out, plugins, ARRAY_SIZE(plugins));
+}
+
+static void yacc_dumpbind(struct ctx *ctx)
+{
+	const char *conv[] = {
+		"static int cli_bindfail(void)",
+		"{",
+		"	lasterr.kind = CLI_ERR_VALUE;",
+		"	lasterr.argi = argbase + @yycurarg;",
+		"",
+		"	return -1;",
+		"}",
+		"",
+		"static int cli_bindsigned(const char *str, long long min, long long max,",
+		"			  long long *num)",
+		"{",
+		"	char *end;",
+		"",
+		"	errno = 0;",
+		"	*num = strtoll(str, &end, 10);",
+		"	if (errno || end == str || *end || *num < min || *num > max)",
+		"		return cli_bindfail();",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"static int cli_bindunsigned(const char *str, unsigned long long max,",
+		"			    unsigned long long *num)",
+		"{",
+		"	char *end;",
+		"",
+		"	/* strtoull() silently negates '-1' */",
+		"	if (str[strspn(str, \" \\t\")] == '-')",
+		"		return cli_bindfail();",
+		"	errno = 0;",
+		"	*num = strtoull(str, &end, 10);",
+		"	if (errno || end == str || *end || *num > max)",
+		"		return cli_bindfail();",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"static int cli_bindstr(void *field, const char *str, int seen)",
+		"{",
+		"	char *dup = strdup(str);",
+		"",
+		"	if (!dup)",
+		"		return -ENOMEM;",
+		"	/* The last one of repeating options wins */",
+		"	if (seen)",
+		"		free(*(char **)field);",
+		"	*(char **)field = dup;",
+		"",
+		"	return 0;",
+		"}",
+		"",
+	};
+	const char *dbl[] = {
+		"static int cli_binddouble(void *field, const char *str, int seen)",
+		"{",
+		"	char *end;",
+		"",
+		"	errno = 0;",
+		"	*(double *)field = strtod(str, &end);",
+		"	if (errno || end == str || *end)",
+		"		return cli_bindfail();",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"static void cli_unbindstr(void *field)",
+		"{",
+		"	free(*(char **)field);",
+		"	*(char **)field = NULL;",
+		"}",
+		"",
+		"static void cli_unbindnop(void *field)",
+		"{",
+		"}",
+		"",
+		"#define CLI_UNBIND(id, field) ({					\\",
+		"	if (CLI_BOUND(id))					\\",
+		"		_Generic(&bindcfg->field,			\\",
+		"			 char **: cli_unbindstr,		\\",
+		"			 const char **: cli_unbindstr,		\\",
+		"			 default: cli_unbindnop)(&bindcfg->field);	\\",
+		"})",
+		"",
+	};
+	const char *parse[] = {
+		"{",
+		"	struct @cli cli;",
+		"	int rc;",
+		"",
+		"	memset(bindseen, 0, sizeof(bindseen));",
+		"	bindcfg = cfg;",
+		"	rc = @cli_parse(argc, argv, &cli);",
+		"	if (!rc)",
+		"		@cli_free(&cli);",
+		"	else {",
+	};
+	const char *parseend[] = {
+		"	}",
+		"	bindcfg = NULL;",
+		"",
+		"	return rc;",
+		"}",
+		"",
+	};
+	static const struct {
+		const char *name;
+		const char *type;
+		const char *conv;
+	} nums[] = {
+		{ "int",    "int",                "cli_bindsigned(str, INT_MIN, INT_MAX, &num)" },
+		{ "long",   "long",               "cli_bindsigned(str, LONG_MIN, LONG_MAX, &num)" },
+		{ "llong",  "long long",          "cli_bindsigned(str, LLONG_MIN, LLONG_MAX, &num)" },
+		{ "uint",   "unsigned",           "cli_bindunsigned(str, UINT_MAX, &num)" },
+		{ "ulong",  "unsigned long",      "cli_bindunsigned(str, ULONG_MAX, &num)" },
+		{ "ullong", "unsigned long long", "cli_bindunsigned(str, ULLONG_MAX, &num)" },
+	};
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
+	int i;
+
+	print_tmpls(ctx, out, conv, ARRAY_SIZE(conv));
+	for (i = 0; i < ARRAY_SIZE(nums); i++) {
+		/* Conversion is done in the widest type of the same sign */
+		fprintf(out,
+			"static int cli_bind%s(void *field, const char *str, int seen)\n"
+			"{\n"
+			"\t%s num;\n"
+			"\n"
+			"\tif (%s)\n"
+			"\t\treturn -1;\n"
+			"\t*(%s *)field = num;\n"
+			"\n"
+			"\treturn 0;\n"
+			"}\n\n",
+			nums[i].name,
+			nums[i].name[0] == 'u' ? "unsigned long long" : "long long",
+			nums[i].conv, nums[i].type);
+	}
+	print_tmpls(ctx, out, dbl, ARRAY_SIZE(dbl));
+
+	print_tmpl(ctx, out, "@fn int @cli_parse_bind(int argc, char **argv,");
+	fprintf(out, "\t\t   struct %s *cfg)\n", ctx->bindtype);
+	print_tmpls(ctx, out, parse, ARRAY_SIZE(parse));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->bind && (hargs->type == T_STR || hargs->flags & F_VAL))
+			fprintf(out, "\t\tCLI_UNBIND(%d, %s);\n",
+				hargs->bindid, hargs->bind);
+	}
+	print_tmpls(ctx, out, parseend, ARRAY_SIZE(parseend));
+}
+
+struct yacc_altcmd {
+	unsigned icmd;
+	char *match;
+};
+
+struct yacc_alt {
+	char *rule;    /* positional part of the alternative */
+	char *match;   /* options of commands, NULL for groups */
+	unsigned icmd;
+	struct yacc_altcmd *cmds; /* commands of the same rule or NULL */
+	unsigned cmdsnum;
+};
+
+struct yacc_alts {
+	struct yacc_alt *alts;
+	unsigned num;
+};
+
+static void yacc_getalts(struct ctx *ctx, struct yacc_alts *alts,
+			 struct list_head *args, unsigned icmd,
+			 const char *match, struct arg *grp, unsigned *ialts);
+static void yacc_freealts(struct yacc_alts *alts);
+
+/*
+ * Usage line without groups and arrays of positional arguments is
+ * a fixed sequence of tokens, which is compared in a row.
+ */
+static bool cmd_issimple(struct ctx *ctx, struct cmd *cmd)
+{
+	bool havepos = false;
+	struct arg *arg;
+
+	list_for_each_entry(arg, &cmd->args, argsent) {
+		if (!arg_haspos(arg))
+			continue;
+		if (arg_isgroup(arg) || ctx_isarr(ctx, arg))
+			return false;
+		havepos = true;
+	}
+
+	/* Alternatives of options only are the same empty rule */
+	return !havepos || !args_havesep(&cmd->args);
+}
+
+/* Positional tokens of a simple command, groups of options are skipped */
+static unsigned cmd_poslen(struct cmd *cmd)
+{
+	struct arg *arg;
+	unsigned len = 0;
+
+	list_for_each_entry(arg, &cmd->args, argsent) {
+		if (arg_haspos(arg))
+			len += 1;
+	}
+
+	return len;
+}
+
+/* Alternative of a simple command, see yacc_addalt() */
+static unsigned cmd_alt(struct ctx *ctx, struct cmd *cmd,
+			struct yacc_alts *alts)
+{
+	struct yacc_alts own = {};
+	unsigned i;
+
+	yacc_getalts(ctx, &own, &cmd->args, 0, NULL, NULL, NULL);
+	for (i = 0; i < alts->num; i++) {
+		if (!strcmp(alts->alts[i].rule, own.alts[0].rule))
+			break;
+	}
+	yacc_freealts(&own);
+	assert(i < alts->num);
+
+	return i;
+}
+
+static void yacc_dumpfast(struct ctx *ctx, struct yacc_alts *alts)
+{
+	const char *fastopt[] = {
+		"",
+		"/*",
+		" * Option given by its exact name: returns its id, -1 if not an",
+		" * option or -2 if argument can't be taken without the scanner.",
+		" */",
+		"static int cli_fastopt(const char *arg, const struct cli_arg *cls,",
+		"		       const char **val)",
+		"{",
+		"	int id, node;",
+		"",
+		"	*val = NULL;",
+		"	/* Scanner skips empty arguments and splits words by '=' */",
+		"	if (cls->kind == CLI_ARG_WORD)",
+		"		return -1;",
+		"	if (cls->kind == CLI_ARG_EMPTY || cls->kind == CLI_ARG_EQ)",
+		"		return -2;",
+		"	if (cls->kind == CLI_ARG_SHORT) {",
+		"		id = cli_shortopt(arg, cls->eq);",
+		"	} else {",
+		"		node = cli_trienode(arg + 2, cls->eq - 2);",
+		"		id = node < 0 ? -1 : cli_trie[node].id;",
+		"	}",
+		"	/* Abbreviations and words starting with '-' */",
+		"	if (id < 0 || (cls->len > cls->eq && !cli_optvalued[id]))",
+		"		return -2;",
+		"	if (cls->len == cls->eq)",
+		"		return id;",
+		"	*val = arg + cls->eq + 1;",
+		"	if (cls->len == cls->eq + 1 || cls->eqs > 1)",
+		"		return -2;",
+		"",
+		"	return id;",
+		"}",
+		"",
+		"/*",
+		" * Simple usage lines are matched without scanner and parser:",
+		" * positional arguments are compared with the tokens of each line",
+		" * in a row, options are taken in the second pass.  Returns 1 if",
+		" * argv is left for the grammar.",
+		" */",
+		"static int cli_fastparse(int argc, char **argv, struct @cli *cli)",
+		"{",
+		"	const struct cli_arg *cls;",
+		"	const char *val;",
+		"	unsigned n = 0;",
+		"	int i, id, rc;",
+	};
+	const char *collect[] = {
+		"",
+		"	for (i = 1; i < argc; i++) {",
+		"		cls = cli_argclass(argc, argv, i);",
+		"		id = cli_fastopt(argv[i], cls, &val);",
+		"		if (id == -2)",
+		"			return 1;",
+		"		if (id >= 0) {",
+		"			if (val || !cli_optvalued[id])",
+		"				continue;",
+		"			/* Value is the next argument */",
+		"			i += 1;",
+		"			if (i == argc)",
+		"				return 1;",
+		"			cls = cli_argclass(argc, argv, i);",
+		"			if (cls->len == 0 || cls->eqs)",
+		"				return 1;",
+		"			continue;",
+		"		}",
+		"		if (n == sizeof(pos) / sizeof(pos[0]))",
+		"			return 1;",
+		"		pos[n] = i;",
+		"		tok[n++] = cli_wordtok(argv[i], cls->len);",
+		"	}",
+		"",
+	};
+	const char *options[] = {
+		"	} else",
+		"		return 1;",
+		"",
+		"	for (i = 1; i < argc; i++) {",
+		"		id = cli_fastopt(argv[i], cli_argclass(argc, argv, i), &val);",
+		"		if (id < 0)",
+		"			continue;",
+		"		@yycurarg = i;",
+		"		@yyoption(cli, id);",
+		"		if (!cli_optvalued[id])",
+		"			continue;",
+		"		if (val == NULL)",
+		"			val = argv[++i];",
+		"		rc = @yyoptval(cli, val);",
+		"		if (rc)",
+		"			return rc;",
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+	};
+	FILE *out = ctx->yyaccout;
+	unsigned maxlen = 0, len, ialt, k;
+	struct hashed_args *hargs;
+	bool *done, first = true;
+	struct arg *arg;
+	struct cmd *cmd;
+	char val[32];
+
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		if (!cmd_issimple(ctx, cmd))
+			continue;
+		len = cmd_poslen(cmd);
+		if (len > maxlen)
+			maxlen = len;
+	}
+
+	print_tmpls(ctx, out, fastopt, ARRAY_SIZE(fastopt));
+	fprintf(out, "	unsigned tok[%u];\n", maxlen + 1);
+	fprintf(out, "	int pos[%u];\n", maxlen + 1);
+	print_tmpls(ctx, out, collect, ARRAY_SIZE(collect));
+
+	/* Equal lines have one alternative, the first one is taken */
+	done = calloc(alts->num, sizeof(*done));
+	assert(done);
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		if (!cmd_issimple(ctx, cmd))
+			continue;
+		ialt = cmd_alt(ctx, cmd, alts);
+		if (done[ialt])
+			continue;
+		done[ialt] = true;
+
+		fprintf(out, "	%sif (n == %u", first ? "" : "} else ",
+			cmd_poslen(cmd));
+		k = 0;
+		list_for_each_entry(arg, &cmd->args, argsent) {
+			if (!arg_haspos(arg))
+				continue;
+			fprintf(out, " && tok[%u] == %u", k++,
+				arg->type == T_STR ? 1 : ctx_peektok(ctx, arg));
+		}
+		fprintf(out, ") {\n");
+		k = 0;
+		list_for_each_entry(arg, &cmd->args, argsent) {
+			if (!arg_haspos(arg))
+				continue;
+			hargs = ctx_findarg(ctx, arg->name);
+			fprintf(out, "		");
+			if (arg->type == T_STR) {
+				/* Values of bound fields are checked */
+				if (hargs->bind)
+					fprintf(out, "%scurarg = pos[%u];\n\t\t",
+						ctx->yyprefix, k);
+				snprintf(val, sizeof(val), "argv[pos[%u]]", k);
+				yacc_dumpset(ctx, out, hargs, val);
+			} else
+				yacc_dumpset(ctx, out, hargs, NULL);
+			fprintf(out, "\n");
+			k++;
+		}
+		/* Usage line of an options error, see cli_errcmd() */
+		list_for_each_entry(arg, &cmd->args, argsent) {
+			if (!arg_haspos(arg))
+				continue;
+			fprintf(out, "		cli_track(");
+			if (arg->type == T_STR)
+				fprintf(out, "WORD");
+			else
+				print_strtoupper(out, arg->name);
+			fprintf(out, ");\n");
+		}
+		fprintf(out, "		optalt = %u;\n", ialt);
+		first = false;
+	}
+	free(done);
+	if (first)
+		fprintf(out, "	if (0) {\n");
+	print_tmpls(ctx, out, options, ARRAY_SIZE(options));
+}
+
+/*
+ * Alternative of the grammar is told by 'optalt'.  Usage lines which
+ * differ in options only are one alternative, so the line is told by
+ * the seen options.
+ */
+static void yacc_dumpaltcmds(struct ctx *ctx, struct yacc_alts *alts)
+{
+	FILE *out = ctx->yyaccout;
+	struct yacc_alt *alt;
+	bool first = true;
+	unsigned i, j;
+
+	fprintf(out, "/* Usage lines of alternatives of the grammar */\n");
+	fprintf(out, "static const unsigned cli_altcmds[] = {");
+	for (i = 0; i < alts->num; i++)
+		fprintf(out, "%s%u", i ? ", " : " ", alts->alts[i].icmd);
+	fprintf(out, " };\n\n");
+
+	fprintf(out, "static unsigned cli_matchedcmd(void)\n{\n");
+	for (i = 0; i < alts->num; i++) {
+		alt = &alts->alts[i];
+		if (!alt->cmdsnum)
+			continue;
+		if (first)
+			fprintf(out, "	switch (optalt) {\n");
+		first = false;
+		fprintf(out, "	case %u:\n", i);
+		for (j = 0; j < alt->cmdsnum - 1; j++)
+			fprintf(out, "		if (%s)\n			return %u;\n",
+				alt->cmds[j].match, alt->cmds[j].icmd);
+		fprintf(out, "		return %u;\n", alt->cmds[j].icmd);
+	}
+	if (!first)
+		fprintf(out, "	}\n\n");
+	fprintf(out, "	return cli_altcmds[optalt];\n}\n\n");
+}
+
+/*
+ * The union of usage lines is taken by the line of the first written
+ * field.  Fields of another line are not written then: options of two
+ * lines or an option of a line which is not matched fail the check of
+ * options anyway, and the grammar reduces actions of the matched line
+ * only.
+ */
+static void yacc_dumpunion(struct ctx *ctx)
+{
+	const char *take[] = {
+		"};",
+		"",
+		"static int cli_take(struct @cli *cli, unsigned cmd)",
+		"{",
+		"	if (cli->_cmd == cmd)",
+		"		return 1;",
+		"	if (cli->_cmd)",
+		"		return 0;",
+		"	cli->_cmd = cmd;",
+		"	memset((char *)cli + cli_cmds[cmd].offset, 0, cli_cmds[cmd].size);",
+		"",
+		"	return 1;",
+		"}",
+		"",
+	};
+	FILE *out = ctx->yyaccout;
+	unsigned icmd;
+
+	fprintf(out, "/* Parts of usage lines in the union of 'struct %s' */\n",
+		ctx->prefix);
+	fprintf(out, "static const struct {\n\tsize_t offset;\n\tsize_t size;\n");
+	fprintf(out, "} cli_cmds[] = {\n\t{ 0, 0 },\n");
+	for (icmd = 1; icmd <= ctx->cmdsnum; icmd++) {
+		if (ctx_haspart(ctx, icmd))
+			fprintf(out, "\t{ offsetof(struct %s, cmd%u), "
+				"sizeof(((struct %s *)0)->cmd%u) },\n",
+				ctx->prefix, icmd, ctx->prefix, icmd);
+		else
+			fprintf(out, "\t{ 0, 0 },\n");
+	}
+	print_tmpls(ctx, out, take, ARRAY_SIZE(take));
+}
+
+static void yacc_dumpfooter(struct ctx *ctx, struct yacc_alts *alts)
+{
+	const char *footer1[] = {
+		"",
+		"/*",
+		" * Scanner can't return an error when it fails to allocate its",
+		" * buffers, so jump back to @cli_parse_alloc() instead of exit().",
+		" */",
+		"@fn void @yyfatal(const char *msg)",
+		"{",
+		"	longjmp(fatal, 1);",
+		"}",
+		"",
+	};
+	const char *alloc[] = {
+		"static void *cli_noalloc(void *ctx, size_t size)",
+		"{",
+		"	return NULL;",
+		"}",
+		"",
+		"static void *cli_norealloc(void *ctx, void *ptr, size_t size)",
+		"{",
+		"	return NULL;",
+		"}",
+		"",
+		"static void cli_nofree(void *ctx, void *ptr)",
+		"{",
+		"}",
+		"",
+		"/* Results of @cli_parse_into() are never freed */",
+		"static const struct @cli_allocator cli_noallocator = {",
+		"	.alloc   = cli_noalloc,",
+		"	.realloc = cli_norealloc,",
+		"	.free    = cli_nofree,",
+		"};",
+		"",
+		"/*",
+		" * Bump allocator over caller provided storage.  Each block is",
+		" * prefixed with its size, so the last block can be grown or",
+		" * released in place and others can be copied on realloc.",
+		" */",
+		"struct cli_arena {",
+		"	char *buf;",
+		"	size_t size;",
+		"	size_t off;",
+		"};",
+		"",
+		"#define CLI_ARENA_ALIGN (2 * sizeof(size_t))",
+		"",
+		"static void *cli_arenaalloc(void *ctx, size_t size)",
+		"{",
+		"	struct cli_arena *arena = ctx;",
+		"	uintptr_t ptr;",
+		"	size_t off;",
+		"",
+		"	ptr = (uintptr_t)arena->buf + arena->off + sizeof(size_t);",
+		"	ptr = (ptr + CLI_ARENA_ALIGN - 1) & ~(uintptr_t)(CLI_ARENA_ALIGN - 1);",
+		"	off = ptr - (uintptr_t)arena->buf;",
+		"	if (off > arena->size || size > arena->size - off)",
+		"		return NULL;",
+		"	((size_t *)ptr)[-1] = size;",
+		"	arena->off = off + size;",
+		"",
+		"	return (void *)ptr;",
+		"}",
+		"",
+		"static void *cli_arenarealloc(void *ctx, void *ptr, size_t size)",
+		"{",
+		"	struct cli_arena *arena = ctx;",
+		"	size_t off, oldsz;",
+		"	void *newptr;",
+		"",
+		"	if (ptr == NULL)",
+		"		return cli_arenaalloc(ctx, size);",
+		"",
+		"	oldsz = ((size_t *)ptr)[-1];",
+		"	off = (char *)ptr - arena->buf;",
+		"	if (off + oldsz == arena->off) {",
+		"		if (size > arena->size - off)",
+		"			return NULL;",
+		"		((size_t *)ptr)[-1] = size;",
+		"		arena->off = off + size;",
+		"",
+		"		return ptr;",
+		"	}",
+		"	newptr = cli_arenaalloc(ctx, size);",
+		"	if (newptr)",
+		"		memcpy(newptr, ptr, oldsz < size ? oldsz : size);",
+		"",
+		"	return newptr;",
+		"}",
+		"",
+		"static void cli_arenafree(void *ctx, void *ptr)",
+		"{",
+		"	struct cli_arena *arena = ctx;",
+		"	size_t off;",
+		"",
+		"	if (ptr == NULL)",
+		"		return;",
+		"	off = (char *)ptr - arena->buf;",
+		"	if (off + ((size_t *)ptr)[-1] == arena->off)",
+		"		arena->off = off - sizeof(size_t);",
+		"}",
+		"",
+	};
+	const char *rtalloc[] = {
+		"#define cli_noallocator docopt_noallocator",
+		"#define cli_arena docopt_arena",
+		"#define cli_arenaalloc docopt_arenaalloc",
+		"#define cli_arenarealloc docopt_arenarealloc",
+		"#define cli_arenafree docopt_arenafree",
+		"",
+	};
+	const char *yyalloc[] = {
+		"static void *cli_yymalloc(size_t size)",
+		"{",
+		"	return @yyallocator->alloc(@yyallocator->ctx, size);",
+		"}",
+		"",
+		"static void cli_yyfree(void *ptr)",
+		"{",
+		"	@yyallocator->free(@yyallocator->ctx, ptr);",
+		"}",
+		"",
+	};
+	const char *footer2[] = {
+		"/*",
+		" * Parser is a push parser driven either by the argument array or",
+		" * by pushed arguments.  Scanner keeps its start condition between",
+		" * arguments, so a value of an option can be the next argument.",
+		" */",
+		"static yypstate *pstate;",
+		"static YY_BUFFER_STATE pushbuf;",
+		"static char *pushargv[1];",
+		"",
+		"static int cli_parse_begin(struct @cli *cli,",
+		"			   const struct @cli_allocator *alloc)",
+		"{",
+		"	if (pstate)",
+		"		return -EBUSY;",
+		"",
+	};
+	const char *footer3[] = {
+		"	cli->_alloc = alloc ?: &cli_stdallocator;",
+		"	@yyallocator = cli->_alloc;",
+		"	error = 0;",
+		"	memset(optseen, 0, sizeof(optseen));",
+		"	optpending = -1;",
+		"	memset(&lasterr, 0, sizeof(lasterr));",
+		"	lasterr.argi = -1;",
+		"	argbase = 0;",
+		"	prefixlen = 0;",
+		"	@yyargc = 1;",
+		"	@yycurarg = 0;",
+		"",
+		"	pstate = yypstate_new();",
+		"	if (pstate == NULL) {",
+		"		lasterr.kind = CLI_ERR_NOMEM;",
+		"		return -ENOMEM;",
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"static int cli_parse_end(struct @cli *cli, int rc)",
+		"{",
+		"	yypstate_delete(pstate);",
+		"	pstate = NULL;",
+		"	/* Deleted by @yyscanfree() */",
+		"	pushbuf = NULL;",
+		"	@yyscanfree();",
 		"",
-		"static int error;",
+		"	/* Allocation failures are returned from actions */",
+		"	if (rc < 0)",
+		"		error = rc;",
+		"	else if (rc == 2)",
+		"		error = -ENOMEM;",
+		"	else if (rc && !error)",
+		"		error = -1;",
+		"	/* Input is parsed, so all options are seen */",
+		"	if (!error && optpending >= 0) {",
+		"		error = -1;",
+		"		lasterr.kind = CLI_ERR_MISSING;",
+		"		lasterr.argi = argbase + @yycurarg;",
+		"	} else if (!error && !cli_optcheck()) {",
+		"		error = -1;",
+		"		lasterr.kind = CLI_ERR_OPTIONS;",
+		"		/* Options of a line are missing rather if nothing is given */",
+		"		if (argbase + @yyargc == 1) {",
+		"			lasterr.kind = CLI_ERR_MISSING;",
+		"			lasterr.argi = 1;",
+		"		}",
+		"	} else if (!error && !validating) {",
+		"		/* Values of variables are not in argv */",
+		"		error = cli_env(cli);",
+		"		if (error)",
+		"			lasterr.argi = -1;",
+		"	}",
+	};
+	const char *footer4[] = {
+		"	if (error == -ENOMEM) {",
+		"		lasterr.kind = CLI_ERR_NOMEM;",
+		"		lasterr.argi = -1;",
+		"	} else if (error && !lasterr.kind)",
+		"		lasterr.kind = CLI_ERR_SYNTAX;",
+		"	if (error) {",
+		"		lasterr.cmd = cli_errcmd();",
+		"		@cli_free(cli);",
+		"	}",
 		"",
-		"int yyargc;",
-		"int yycurarg;",
-		"char **yyargv;",
+		"	return error;",
+		"}",
 		"",
-		"struct cli;",
+		"@fn int @cli_parse_alloc(int argc, char **argv, struct @cli *cli,",
+		"		    const struct @cli_allocator *alloc)",
+		"{",
+		"	YY_BUFFER_STATE buf;",
+		"	int rc;",
 		"",
-		"int yylex(struct cli *cli);",
-		"void yyerror(struct cli *cli, const char *err);",
-		"int yylex_destroy(void);",
+		"	rc = cli_parse_begin(cli, alloc);",
+		"	if (rc)",
+		"		return rc;",
 		"",
-		"typedef struct yy_buffer_state* YY_BUFFER_STATE;",
-		"void yy_switch_to_buffer(YY_BUFFER_STATE buf);",
-		"YY_BUFFER_STATE yy_scan_string(const char *yy_str);",
+		"	if (setjmp(fatal))",
+		"		return cli_parse_end(cli, -ENOMEM);",
 		"",
-		"#define CLI_STRDUP(ptr, member, str) ({		\\",
-		"	(ptr)->member = strdup(str);		\\",
-		"	if (!(ptr)->member)			\\",
-		"		return -ENOMEM;			\\",
-		"});",
+		"	if (argc < 1)",
+		"		return cli_parse_end(cli, -1);",
+		"	@yyargc = argc;",
+		"	@yyargv = argv;",
+		"	argwinnum = 0;",
+		"	rc = cli_fastparse(argc, argv, cli);",
+		"	if (rc <= 0)",
+		"		return cli_parse_end(cli, rc);",
 		"",
-		"#define CLI_STRDUP_ARR(ptr, member, str) ({			\\",
-		"	char **newarr;						\\",
-		"	size_t oldsz, num;					\\",
-		"								\\",
-		"	num = (ptr)->member ## _num;				\\",
-		"	oldsz = sizeof(*newarr) * num;				\\",
-		"	newarr = malloc(sizeof(*newarr) + oldsz);		\\",
-		"	if (!newarr)						\\",
-		"		return -ENOMEM;					\\",
-		"	if (oldsz)						\\",
-		"		memcpy(newarr, (ptr)->member ## _arr, oldsz);	\\",
-		"	free((ptr)->member ## _arr);				\\",
-		"	(ptr)->member ## _arr = newarr;				\\",
-		"	(ptr)->member ## _arr[num] = strdup(str);		\\",
-		"	if (!(ptr)->member ## _arr[num])			\\",
-		"		return -ENOMEM;					\\",
-		"	(ptr)->member ## _num += 1;				\\",
-		"});",
+		"	/*",
+		"	 * Scanner starts with an empty buffer, so the first argument",
+		"	 * is taken by <<EOF>> rule as others are.",
+		"	 */",
+		"	@yycurarg = 0;",
+		"	buf = @yyscanarg(\"\");",
+		"	if (buf == NULL)",
+		"		return cli_parse_end(cli, -ENOMEM);",
+		"	@yy_switch_to_buffer(buf);",
 		"",
-		"%}",
-		"%code requires {",
-	};
-	static const char *header2[] = {
+		"	/* Impure parser takes the token from yychar & yylval */",
+		"	do {",
+		"		yychar = yylex(cli);",
+		"		cli_track(yychar);",
+		"		rc = yypush_parse(pstate, cli);",
+		"	} while (rc == YYPUSH_MORE);",
+		"",
+		"	return cli_parse_end(cli, rc);",
 		"}",
-		"%parse-param { struct cli *cli }",
-		"%lex-param { struct cli *cli }",
-		"%union {",
-		"	const char *str;",
+		"",
+		"@fn int @cli_parse(int argc, char **argv, struct @cli *cli)",
+		"{",
+		"	return @cli_parse_alloc(argc, argv, cli, NULL);",
 		"}",
-		"%define parse.error verbose",
 		"",
-		"%start commands",
+		"/*",
+		" * Results go to a scratch struct, which holds flags only: strings",
+		" * are not copied and arrays are not grown, variables are not read.",
+		" */",
+		"@fn int @cli_validate(int argc, char **argv)",
+		"{",
+		"	struct @cli cli;",
+		"	int rc;",
 		"",
-	};
-	FILE *out = ctx->yyaccout;
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(header1); i++)
-		fprintf(out, "%s\n", header1[i]);
-	fprintf(out, "#include \"%s.h\"\n", ctx->basename);
-	for (i = 0; i < ARRAY_SIZE(header2); i++)
-		fprintf(out, "%s\n", header2[i]);
-
-	yacc_dumptokens(ctx);
-}
-
-static void yacc_dumpfooter(struct ctx *ctx)
-{
-	const char *footer1[] = {
+		"	validating = 1;",
+		"	rc = @cli_parse_alloc(argc, argv, &cli, NULL);",
+		"	validating = 0;",
+		"",
+		"	return rc ?: (int)cli_matchedcmd();",
+		"}",
 		"",
-		"void yyerror(struct cli *cli, const char *errstr)",
+		"@fn int @cli_parse_into(int argc, char **argv, struct @cli *cli,",
+		"		   void *buf, size_t size)",
 		"{",
-		"	if (yycurarg >= yyargc)",
-		"		fprintf(stderr, \"\\nError: required parameter is missing\\n\\n\");",
-		"	else",
-		"		fprintf(stderr, \"\\nError: %d parameter '%s' is incorrect\\n\\n\",",
-		"			yycurarg, yyargv[yycurarg]);",
-		"	error = -1;",
+		"	struct cli_arena arena = {",
+		"		.buf  = buf,",
+		"		.size = size,",
+		"	};",
+		"	struct @cli_allocator alloc = {",
+		"		.alloc   = cli_arenaalloc,",
+		"		.realloc = cli_arenarealloc,",
+		"		.free    = cli_arenafree,",
+		"		.ctx     = &arena,",
+		"	};",
+		"	int rc;",
+		"",
+		"	rc = @cli_parse_alloc(argc, argv, cli, &alloc);",
+		"	cli->_alloc = &cli_noallocator;",
+		"",
+		"	return rc;",
 		"}",
 		"",
-		"void cli_free(struct cli *cli)",
+		"@fn int @cli_push_begin(struct @cli *cli,",
+		"		   const struct @cli_allocator *alloc)",
 		"{",
-	};
-	const char *footer2[] = {
+		"	return cli_parse_begin(cli, alloc);",
 		"}",
 		"",
-		"int cli_parse(int argc, char **argv, struct cli *cli)",
+		"@fn int @cli_push_arg(struct @cli *cli, const char *arg)",
 		"{",
-		"	static char *empty_argv[] = {\"\"};",
-		"	YY_BUFFER_STATE buf;",
+		"	int rc = YYPUSH_MORE;",
 		"",
-		"	memset(cli, 0, sizeof(*cli));",
+		"	if (pstate == NULL)",
+		"		return -EINVAL;",
+		"	if (setjmp(fatal))",
+		"		return cli_parse_end(cli, -ENOMEM);",
 		"",
-		"	if (argc < 1)",
-		"		return -1;",
-		"	else if (argc == 1) {",
-		"		yycurarg = 0;",
-		"		yyargc = 1;",
-		"		yyargv = empty_argv;",
-		"	} else {",
-		"		yycurarg = 1;",
-		"		yyargc = argc;",
-		"		yyargv = argv;",
+		"	/* Token values point to the buffer of the previous argument */",
+		"	if (pushbuf)",
+		"		@yy_delete_buffer(pushbuf);",
+		"	pushbuf = @yyscanarg(arg);",
+		"	if (pushbuf == NULL)",
+		"		return cli_parse_end(cli, -ENOMEM);",
+		"	@yy_switch_to_buffer(pushbuf);",
+		"",
+		"	/* Argument is the last one for the scanner */",
+		"	argbase += 1;",
+		"	pushargv[0] = (char *)arg;",
+		"	@yyargv = pushargv;",
+		"	@yyargc = 1;",
+		"	@yycurarg = 0;",
+		"",
+		"	while (rc == YYPUSH_MORE && !error) {",
+		"		yychar = yylex(cli);",
+		"		if (yychar == 0)",
+		"			break;",
+		"		cli_track(yychar);",
+		"		rc = yypush_parse(pstate, cli);",
 		"	}",
+		"	if (rc != YYPUSH_MORE || error)",
+		"		return cli_parse_end(cli, rc == YYPUSH_MORE ? 0 : rc);",
 		"",
-		"	buf = yy_scan_string(yyargv[yycurarg]);",
-		"	if (buf == NULL)",
-		"		return -1;",
-		"	yy_switch_to_buffer(buf);",
-		"	yyparse(cli);",
-		"	yylex_destroy();",
+		"	return 0;",
+		"}",
 		"",
-		"	if (error)",
-		"		cli_free(cli);",
+		"@fn int @cli_push_end(struct @cli *cli)",
+		"{",
+		"	if (pstate == NULL)",
+		"		return -EINVAL;",
+		"	if (setjmp(fatal))",
+		"		return cli_parse_end(cli, -ENOMEM);",
 		"",
-		"	return error;",
+		"	@yycurarg = @yyargc;",
+		"	yychar = 0;",
+		"",
+		"	return cli_parse_end(cli, yypush_parse(pstate, cli));",
 		"}",
 		"",
-		"#ifdef MAIN_EXAMPLE",
-		"int main(int argc, char **argv)",
+		"@fn void @cli_push_abort(struct @cli *cli)",
 		"{",
-		"	struct cli cli;",
+		"	if (pstate == NULL)",
+		"		return;",
+		"	yypstate_delete(pstate);",
+		"	pstate = NULL;",
+		"	/* Deleted by @yyscanfree() */",
+		"	pushbuf = NULL;",
+		"	@yyscanfree();",
+		"	@cli_free(cli);",
+		"}",
+		"",
 	};
-	const char *footer3[] = {
+	const char *split[] = {
+		"/*",
+		" * Splits the next word of the line in place: quotes and escapes",
+		" * are removed and the word is terminated with NUL.  The word is",
+		" * NULL at the end of the line.",
+		" */",
+		"static int cli_splitword(char **pline, char **pword)",
+		"{",
+		"	char *r = *pline, *w, quote = 0;",
 		"",
-		"	rc = cli_parse(argc, argv, &cli);",
-		"	if (rc) {",
-		"		fprintf(stderr, \"%s\\n\", cli_usage);",
-		"		return -1;",
+		"	while (*r == ' ' || *r == '\\t' || *r == '\\n')",
+		"		r++;",
+		"	if (*r == '\\0') {",
+		"		*pword = NULL;",
+		"		return 0;",
 		"	}",
-	};
-	const char *footer4[] = {
-		"	cli_free(&cli);",
+		"	for (*pword = w = r; *r; r++) {",
+		"		if (quote == '\\'') {",
+		"			if (*r == '\\'')",
+		"				quote = 0;",
+		"			else",
+		"				*w++ = *r;",
+		"		} else if (quote == '\"') {",
+		"			if (*r == '\"')",
+		"				quote = 0;",
+		"			else if (*r == '\\\\' && (r[1] == '\"' || r[1] == '\\\\'))",
+		"				*w++ = *++r;",
+		"			else",
+		"				*w++ = *r;",
+		"		} else if (*r == '\\'' || *r == '\"') {",
+		"			quote = *r;",
+		"		} else if (*r == '\\\\') {",
+		"			if (r[1] == '\\0')",
+		"				return -EINVAL;",
+		"			*w++ = *++r;",
+		"		} else if (*r == ' ' || *r == '\\t' || *r == '\\n') {",
+		"			r++;",
+		"			break;",
+		"		} else",
+		"			*w++ = *r;",
+		"	}",
+		"	if (quote)",
+		"		return -EINVAL;",
+		"	*w = '\\0';",
+		"	*pline = r;",
 		"",
 		"	return 0;",
 		"}",
-		"#endif",
+		"",
+	};
+	const char *line[] = {
+		"@fn int @cli_parse_line(char *line, struct @cli *cli)",
+		"{",
+		"	char *word;",
+		"	int rc;",
+		"",
+		"	rc = @cli_push_begin(cli, NULL);",
+		"	if (rc)",
+		"		return rc;",
+		"",
+		"	/* Each word is parsed as soon as it is split */",
+		"	for (;;) {",
+		"		rc = cli_splitword(&line, &word);",
+		"		if (rc) {",
+		"			lasterr.kind = CLI_ERR_QUOTE;",
+		"			lasterr.argi = argbase + 1;",
+		"			return cli_parse_end(cli, rc);",
+		"		}",
+		"		if (word == NULL)",
+		"			break;",
+		"		rc = @cli_push_arg(cli, word);",
+		"		if (rc)",
+		"			return rc;",
+		"	}",
+		"",
+		"	return @cli_push_end(cli);",
+		"}",
 	};
 	FILE *out = ctx->yyaccout;
-	struct hashed_args *hargs;
-	int i;
 
-	for (i = 0; i < ARRAY_SIZE(footer1); i++)
-		fprintf(out, "%s\n", footer1[i]);
+	yacc_dumperror(ctx);
+	print_tmpls(ctx, out, footer1, ARRAY_SIZE(footer1));
+	code_dumpstdalloc(ctx, out);
+	if (ctx->runtime)
+		print_tmpls(ctx, out, rtalloc, ARRAY_SIZE(rtalloc));
+	else
+		print_tmpls(ctx, out, alloc, ARRAY_SIZE(alloc));
+	print_tmpls(ctx, out, yyalloc, ARRAY_SIZE(yyalloc));
+	code_dumpresults(ctx, out);
+	yacc_dumpaltcmds(ctx, alts);
+	if (ctx->tagged)
+		yacc_dumpunion(ctx);
+
+	yacc_dumpoptions(ctx);
+	if (ctx->image)
+		yacc_dumpimage(ctx);
+	yacc_dumppeek(ctx);
+	yacc_dumpclassify(ctx);
+	yacc_dumpfast(ctx, alts);
+	code_dumpenv(ctx, out);
+
+	print_tmpls(ctx, out, footer2, ARRAY_SIZE(footer2));
+	/* Parts of usage lines are cleared when they are taken */
+	if (ctx->tagged)
+		fprintf(out, "	memset(cli, 0, offsetof(struct %s, cmd%u));\n",
+			ctx->prefix, ctx_firstpart(ctx));
+	else
+		fprintf(out, "	memset(cli, 0, sizeof(*cli));\n");
+	if (ctx->grpsnum)
+		fprintf(out, "	memset(grpalts, -1, sizeof(grpalts));\n");
+	print_tmpls(ctx, out, footer3, ARRAY_SIZE(footer3));
+	/* Usage lines which wrote nothing are tagged as well */
+	if (ctx->tagged)
+		fprintf(out, "	if (!error)\n"
+			"		cli_take(cli, cli_matchedcmd());\n");
+	print_tmpls(ctx, out, footer4, ARRAY_SIZE(footer4));
+	if (ctx->runtime)
+		fprintf(out, "#define cli_splitword docopt_splitword\n\n");
+	else
+		print_tmpls(ctx, out, split, ARRAY_SIZE(split));
+	print_tmpls(ctx, out, line, ARRAY_SIZE(line));
+	if (ctx->cachesize)
+		yacc_dumpcache(ctx);
+	if (ctx->runtime)
+		yacc_dumpplugins(ctx);
+	if (ctx->bindsnum)
+		yacc_dumpbind(ctx);
+	code_dumpvisit(ctx, out);
+	code_dumpmain(ctx, out);
 
-	if (ctx->havearrays)
-		fprintf(out, "	unsigned i;\n\n");
+	/*
+	 * Scanner goes to the same translation unit, so everything
+	 * can be static and the whole parser is a single include
+	 */
+	if (ctx->embed)
+		fprintf(out, "\n#include \"%s.lex.c\"\n", ctx->basename);
+}
+
+static void yacc_dumprules(struct ctx *ctx)
+{
+	FILE *out = ctx->yyaccout;
+	struct hashed_args *hargs;
 
 	/*
-	 * Print free for char* members of CLI structure
+	 * Arrays (repating strings) require separate yacc rules,
+	 * repeating options are collected by the scanner.
 	 */
 	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
-		if (hargs->type != T_STR)
+		int len;
+
+		if (hargs->optid >= 0 || !(hargs->flags & F_ARR))
 			continue;
-		if (hargs->flags & F_ARR) {
-			fprintf(out, "	for (i = 0; i < cli->");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "_num; i++)\n");
-			fprintf(out, "		free(cli->");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "_arr[i]);\n");
-			fprintf(out, "	free(cli->");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "_arr);\n");
-		} else {
-			fprintf(out, "	free(cli->");
-			print_strtolower(out, hargs->name);
-			fprintf(out, ");\n");
+
+		len = print_strtolower(out, hargs->name);
+		fprintf(out, ": WORD { ");
+		print_take(out, hargs);
+		print_strdup_arr(out, hargs, "$1");
+		fprintf(out, " }\n");
+		fprintf(out, "%*s%s", len, "", "| ");
+		print_strtolower(out, hargs->name);
+		fprintf(out, " WORD { ");
+		print_take(out, hargs);
+		print_strdup_arr(out, hargs, "$2");
+		fprintf(out, " }\n\n");
+	}
+}
+
+/*
+ * Options are matched by the scanner in any position, so usage of
+ * options is checked when a command is reduced: each command gets a
+ * C expression over the set of seen options.  Expressions are built
+ * from 'empty' (no option of an argument is seen) and 'match' (options
+ * of an argument are seen as usage requires) parts, "1" is true.
+ */
+static char *expr_and(char *a, char *b)
+{
+	char *str;
+
+	if (!strcmp(a, "1")) {
+		free(a);
+		return b;
+	}
+	if (!strcmp(b, "1")) {
+		free(b);
+		return a;
+	}
+	str = xasprintf("%s && %s", a, b);
+	free(a);
+	free(b);
+
+	return str;
+}
+
+static bool expr_isand(const char *str)
+{
+	int depth = 0;
+
+	for (; *str; str++) {
+		if (*str == '(')
+			depth++;
+		else if (*str == ')')
+			depth--;
+		else if (!depth && !strncmp(str, "&&", 2))
+			return true;
+	}
+
+	return false;
+}
+
+static char *expr_or(char *a, char *b)
+{
+	char *str;
+
+	if (!strcmp(a, "1")) {
+		free(b);
+		return a;
+	}
+	if (!strcmp(b, "1")) {
+		free(a);
+		return b;
+	}
+	str = xasprintf(expr_isand(a) ? "((%s) || " : "(%s || ", a);
+	free(a);
+	a = str;
+	str = xasprintf(expr_isand(b) ? "%s(%s))" : "%s%s)", a, b);
+	free(a);
+	free(b);
+
+	return str;
+}
+
+static char *expr_empty(struct ctx *ctx, struct arg *arg)
+{
+	struct arg *child;
+	char *str;
+
+	if (arg_isopt(arg))
+		return xasprintf("!CLI_SEEN(%d)", ctx_optid(ctx, arg));
+	str = xasprintf("1");
+	if (arg_isgroup(arg)) {
+		list_for_each_entry(child, &arg->args, argsent)
+			str = expr_and(str, expr_empty(ctx, child));
+	}
+
+	return str;
+}
+
+static char *expr_matchargs(struct ctx *ctx, struct list_head *args,
+			    bool optional);
+static char *expr_matchgrp(struct ctx *ctx, struct arg *grp);
+
+static char *expr_match(struct ctx *ctx, struct arg *arg)
+{
+	if (arg_isopt(arg))
+		return xasprintf("CLI_SEEN(%d)", ctx_optid(ctx, arg));
+	if (arg->grpid >= 0)
+		return expr_matchgrp(ctx, arg);
+	if (arg_isgroup(arg))
+		return expr_matchargs(ctx, &arg->args,
+				      arg->type == T_OPTGRP);
+
+	return xasprintf("1");
+}
+
+/* Alternative 'ibr' of arguments split by '|', others are empty */
+static char *expr_branch(struct ctx *ctx, struct list_head *args,
+			 unsigned ibr)
+{
+	struct arg *arg;
+	unsigned i = 0;
+	char *br;
+
+	br = xasprintf("1");
+	list_for_each_entry(arg, args, argsent) {
+		br = expr_and(br, i == ibr ? expr_match(ctx, arg) :
+					     expr_empty(ctx, arg));
+		if (arg->flags & F_SEP)
+			i += 1;
+	}
+
+	return br;
+}
+
+static char *expr_matchargs(struct ctx *ctx, struct list_head *args,
+			    bool optional)
+{
+	unsigned ibr, nbr;
+	struct arg *arg;
+	char *str, *br;
+
+	nbr = 1;
+	list_for_each_entry(arg, args, argsent) {
+		if (arg->flags & F_SEP)
+			nbr += 1;
+	}
+
+	str = xasprintf("1");
+	if (nbr == 1) {
+		/* Each argument of an optional group is optional */
+		list_for_each_entry(arg, args, argsent) {
+			if (!optional)
+				str = expr_and(str, expr_match(ctx, arg));
+			else if (arg_isgroup(arg))
+				str = expr_and(str,
+					       expr_or(expr_empty(ctx, arg),
+						       expr_match(ctx, arg)));
 		}
+
+		return str;
 	}
-	for (i = 0; i < ARRAY_SIZE(footer2); i++)
-		fprintf(out, "%s\n", footer2[i]);
 
-	if (ctx->havearrays)
-		fprintf(out, "	int rc, i;\n");
-	else
-		fprintf(out, "	int rc;\n");
+	/* Exactly one of alternatives, others are empty */
+	free(str);
+	str = NULL;
+	for (ibr = 0; ibr < nbr; ibr++) {
+		br = expr_branch(ctx, args, ibr);
+		str = str ? expr_or(str, br) : br;
+	}
+	if (optional) {
+		br = xasprintf("1");
+		list_for_each_entry(arg, args, argsent)
+			br = expr_and(br, expr_empty(ctx, arg));
+		str = expr_or(br, str);
+	}
 
-	for (i = 0; i < ARRAY_SIZE(footer3); i++)
-		fprintf(out, "%s\n", footer3[i]);
+	return str;
+}
 
-	/*
-	 * Print all members as an example
-	 */
+static bool cmd_hasopt(struct cmd *cmd, struct hashed_args *hargs)
+{
+	struct arg *arg;
+
+	list_for_each_entry(arg, &hargs->list, hlistent) {
+		if (arg->cmd == cmd)
+			return true;
+	}
+
+	return false;
+}
+
+static char *expr_cmd(struct ctx *ctx, struct cmd *cmd)
+{
+	struct hashed_args *hargs;
+	char *str;
+
+	str = expr_matchargs(ctx, &cmd->args, false);
 	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
-		if (hargs->type == T_STR) {
-			if (hargs->flags & F_ARR) {
-				fprintf(out, "	for (i = 0; i < cli.");
-				print_strtolower(out, hargs->name);
-				fprintf(out, "_num; i++)\n");
-				fprintf(out, "		printf(\"'");
-				print_strtolower(out, hargs->name);
-				fprintf(out, "_arr[%%d]' = '%%s'\\n\", ");
-				fprintf(out, "i, cli.");
-				print_strtolower(out, hargs->name);
-				fprintf(out, "_arr[i]);\n");
-			} else {
-				fprintf(out, "	printf(\"'");
-				print_strtolower(out, hargs->name);
-				fprintf(out, "' = '%%s'\\n\", ");
-				fprintf(out, "cli.");
-				print_strtolower(out, hargs->name);
-				fprintf(out, ");\n");
+		if (hargs->optid < 0 || cmd_hasopt(cmd, hargs))
+			continue;
+		str = expr_and(str, xasprintf("!CLI_SEEN(%d)", hargs->optid));
+	}
+
+	return str;
+}
+
+static void yacc_addaltcmd(struct yacc_alt *alt, unsigned icmd,
+			   const char *match)
+{
+	struct yacc_altcmd *cmd;
+
+	alt->cmds = xrealloc(alt->cmds, sizeof(*cmd) * (alt->cmdsnum + 1));
+	cmd = &alt->cmds[alt->cmdsnum++];
+	cmd->icmd = icmd;
+	cmd->match = xasprintf("%s", match);
+}
+
+/*
+ * Equal alternatives of different commands make reduce/reduce
+ * conflicts, so the first command gets one alternative, which
+ * accepts options of all of them.
+ */
+static unsigned yacc_addalt(struct yacc_alts *alts, unsigned icmd,
+			    char *rule, char *match)
+{
+	struct yacc_alt *alt;
+	unsigned i;
+
+	for (i = 0; i < alts->num; i++) {
+		alt = &alts->alts[i];
+		if (strcmp(alt->rule, rule))
+			continue;
+		if (match && alt->icmd != icmd) {
+			/* Options tell the command, see yacc_dumpaltcmds() */
+			if (!alt->cmdsnum)
+				yacc_addaltcmd(alt, alt->icmd, alt->match);
+			yacc_addaltcmd(alt, icmd, match);
+			alt->match = expr_or(alt->match, match);
+		} else
+			free(match);
+		free(rule);
+
+		return i;
+	}
+	alts->alts = xrealloc(alts->alts, sizeof(*alt) * (alts->num + 1));
+	alt = &alts->alts[alts->num++];
+	alt->rule = rule;
+	alt->match = match;
+	alt->icmd = icmd;
+	alt->cmds = NULL;
+	alt->cmdsnum = 0;
+
+	return alts->num - 1;
+}
+
+static void yacc_freealts(struct yacc_alts *alts)
+{
+	unsigned i, j;
+
+	for (i = 0; i < alts->num; i++) {
+		free(alts->alts[i].rule);
+		free(alts->alts[i].match);
+		for (j = 0; j < alts->alts[i].cmdsnum; j++)
+			free(alts->alts[i].cmds[j].match);
+		free(alts->alts[i].cmds);
+	}
+	free(alts->alts);
+	alts->alts = NULL;
+	alts->num = 0;
+}
+
+/*
+ * Splits arguments into alternatives by '|' leaving options out of
+ * the grammar.  If 'grp' is given, each argument is an alternative
+ * of that optional group on its own.  'ialts' gets the alternative
+ * of each branch between '|', equal ones are merged.
+ */
+static void yacc_getalts(struct ctx *ctx, struct yacc_alts *alts,
+			 struct list_head *args, unsigned icmd,
+			 const char *match, struct arg *grp, unsigned *ialts)
+{
+	unsigned refs = 0, num = 0, i;
+	struct arg *arg;
+	bool empty = true;
+	size_t size;
+	char *rule;
+	FILE *out;
+
+	out = open_memstream(&rule, &size);
+	if (out == NULL) {
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	list_for_each_entry(arg, args, argsent) {
+		if (arg_haspos(arg)) {
+			if (!empty)
+				fprintf(out, " ");
+			else if (grp && num)
+				fprintf(out, "%s ", grp->name);
+			refs = yacc_dumparg(ctx, out, arg, refs);
+			empty = false;
+		}
+		if (grp ? !empty : (arg->flags & F_SEP ||
+				    list_is_last(&arg->argsent, args))) {
+			if (empty)
+				fprintf(out, "%%empty");
+			fclose(out);
+			i = yacc_addalt(alts, icmd, rule,
+					match ? xasprintf("%s", match) : NULL);
+			if (ialts)
+				ialts[num] = i;
+			num += 1;
+			out = open_memstream(&rule, &size);
+			if (out == NULL) {
+				fprintf(stderr, "Error: out of memory\n");
+				exit(1);
 			}
-		} else {
-			fprintf(out, "	printf(\"'");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "' = '%%d'\\n\", ");
-			fprintf(out, "cli.");
-			print_strtolower(out, hargs->name);
-			fprintf(out, ");\n");
+			empty = true;
 		}
 	}
+	fclose(out);
+	free(rule);
+}
+
+static void yacc_dumpalts(struct ctx *ctx, const char *name,
+			  struct yacc_alts *alts, unsigned icmd, int grpid)
+{
+	FILE *out = ctx->yyaccout;
+	struct yacc_alt *alt;
+	bool first = true;
+	unsigned i;
+
+	for (i = 0; i < alts->num; i++) {
+		alt = &alts->alts[i];
+		if (alt->icmd != icmd)
+			continue;
+		if (first)
+			fprintf(out, "%s: %s", name, alt->rule);
+		else
+			fprintf(out, "%*s| %s", (int)strlen(name), "",
+				alt->rule);
+		if (alt->match)
+			fprintf(out, " { optalt = %u; }", i);
+		else if (grpid >= 0)
+			fprintf(out, " { grpalts[%d] = %u; }", grpid, i);
+		fprintf(out, "\n");
+		first = false;
+	}
+	if (!first)
+		fprintf(out, "\n");
+}
 
-	for (i = 0; i < ARRAY_SIZE(footer4); i++)
-		fprintf(out, "%s\n", footer4[i]);
+/* Alternatives of the rule of a group, 'ialts' as yacc_getalts() */
+static void yacc_getgrpalts(struct ctx *ctx, struct arg *grp,
+			    struct yacc_alts *alts, unsigned *ialts)
+{
+	if (grp->type == T_OPTGRP) {
+		yacc_addalt(alts, 0, xasprintf("%%empty"), NULL);
+		yacc_getalts(ctx, alts, &grp->args, 0, NULL,
+			     args_havesep(&grp->args) ? NULL : grp, ialts);
+	} else
+		yacc_getalts(ctx, alts, &grp->args, 0, NULL, NULL, ialts);
 }
 
-static void yacc_dumprules(struct ctx *ctx)
+static void yacc_dumpgrp(struct ctx *ctx, struct arg *grp)
+{
+	struct yacc_alts alts = {};
+
+	/* Options only group is checked by the command */
+	if (!arg_haspos(grp))
+		return;
+
+	yacc_getgrpalts(ctx, grp, &alts, NULL);
+	yacc_dumpalts(ctx, grp->name, &alts, 0, grp->grpid);
+	yacc_freealts(&alts);
+}
+
+/* Options of the branches of the group which have rule 'ialt' */
+static char *expr_grpalt(struct ctx *ctx, struct arg *grp, unsigned *ialts,
+			 unsigned nbr, unsigned ialt, bool empty)
 {
+	char *str = NULL, *br;
+	unsigned ibr;
+
+	for (ibr = 0; ibr < nbr; ibr++) {
+		if (ialts[ibr] != ialt)
+			continue;
+		br = expr_branch(ctx, &grp->args, ibr);
+		str = str ? expr_or(str, br) : br;
+	}
+	/* Nothing of an optional group */
+	if (empty && grp->type == T_OPTGRP) {
+		br = expr_empty(ctx, grp);
+		str = str ? expr_or(br, str) : br;
+	}
+
+	return str ?: xasprintf("0");
+}
+
+/*
+ * Options of a group with positional arguments and '|' are checked
+ * for the alternative the grammar has taken: its rule records it in
+ * 'grpalts', so e.g. '(<file> | --all)' takes '--all' only without
+ * '<file>'.  Branches of equal rules can't be told, so options of
+ * either of them are taken.  The rule without positional arguments
+ * is also taken if the group is not reduced at all.
+ */
+static char *expr_matchgrp(struct ctx *ctx, struct arg *grp)
+{
+	struct yacc_alts alts = {};
+	unsigned *ialts, nbr = 1, i;
+	char *str, *br, *cond;
+	struct arg *arg;
+	int iempty = -1;
+
+	list_for_each_entry(arg, &grp->args, argsent) {
+		if (arg->flags & F_SEP)
+			nbr += 1;
+	}
+	ialts = xrealloc(NULL, sizeof(*ialts) * nbr);
+	yacc_getgrpalts(ctx, grp, &alts, ialts);
+	for (i = 0; i < alts.num; i++) {
+		if (!strcmp(alts.alts[i].rule, "%empty"))
+			iempty = i;
+	}
+
+	if (iempty >= 0)
+		str = expr_grpalt(ctx, grp, ialts, nbr, iempty, true);
+	else
+		str = xasprintf("0");
+	for (i = alts.num; i-- > 0; ) {
+		if ((int)i == iempty)
+			continue;
+		br = expr_grpalt(ctx, grp, ialts, nbr, i, false);
+		cond = xasprintf("(grpalts[%d] == %u ? %s : %s)", grp->grpid,
+				 i, br, str);
+		free(br);
+		free(str);
+		str = cond;
+	}
+	free(ialts);
+	yacc_freealts(&alts);
+
+	return str;
+}
+
+/*
+ * Each alternative of commands sets 'optalt', options seen by the
+ * scanner are checked against the usage of that alternative.
+ */
+static void yacc_dumpoptcheck(struct ctx *ctx, struct yacc_alts *alts)
+{
+	const char *header[] = {
+		"static int cli_optcheck(void)",
+		"{",
+		"	switch (optalt) {",
+	};
+	const char *footer[] = {
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+	};
 	FILE *out = ctx->yyaccout;
-	struct hashed_args *hargs;
+	unsigned i;
+
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
+	for (i = 0; i < alts->num; i++) {
+		fprintf(out, "	case %u:\n", i);
+		fprintf(out, "		return %s;\n", alts->alts[i].match);
+	}
+	print_tmpls(ctx, out, footer, ARRAY_SIZE(footer));
+}
 
-	/*
-	 * Arrays (repating strings) and arguments with values
-	 * require separate yacc rules.
-	 */
-	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
-		int len;
+/* Groups whose alternative tells their options, see expr_matchgrp() */
+static void ctx_numbergrps(struct ctx *ctx)
+{
+	struct arg *grp;
+	struct cmd *cmd;
 
-		if (hargs->flags & F_VAL) {
-			len = print_strtolower(out, hargs->name);
-			fprintf(out, ": ");
-			print_strtoupper(out, hargs->name);
-			if (hargs->flags & F_ARR)
-				fprintf(out, " WORD { CLI_STRDUP_ARR(cli, ");
-			else
-				fprintf(out, " WORD { CLI_STRDUP(cli, ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, ", $2); }\n");
-			fprintf(out, "%*s%s", len, "", "| ");
-			print_strtoupper(out, hargs->name);
-			if (hargs->flags & F_ARR)
-				fprintf(out, " '=' WORD { CLI_STRDUP_ARR(cli, ");
-			else
-				fprintf(out, " '=' WORD { CLI_STRDUP(cli, ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, ", $3); }\n\n");
-		} else if (hargs->flags & F_ARR) {
-			len = print_strtolower(out, hargs->name);
-			fprintf(out, ": WORD { CLI_STRDUP_ARR(cli, ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, ", $1); }\n");
-			fprintf(out, "%*s%s", len, "", "| ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, " WORD { CLI_STRDUP_ARR(cli, ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, ", $2); }\n\n");
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		list_for_each_entry(grp, &cmd->optgrps, entry) {
+			if (arg_haspos(grp) && args_havesep(&grp->args))
+				grp->grpid = ctx->grpsnum++;
 		}
-
-		/* Additional rule to combining repeating
-		   arguments with values */
-		if ((hargs->flags & F_VAL) && (hargs->flags & F_ARR)) {
-			len = print_strtolower(out, hargs->name);
-			fprintf(out, "-arr: ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "\n");
-			fprintf(out, "%*s%s", len + 4, "", "| ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "-arr ");
-			print_strtolower(out, hargs->name);
-			fprintf(out, "\n\n");
+		list_for_each_entry(grp, &cmd->reqgrps, entry) {
+			if (arg_haspos(grp) && args_havesep(&grp->args))
+				grp->grpid = ctx->grpsnum++;
 		}
 	}
 }
@@ -920,21 +5257,39 @@ static void yacc_dumprules(struct ctx *ctx)
 static void yacc_dump(struct ctx *ctx)
 {
 	FILE *out = ctx->yyaccout;
-	unsigned icmd, igrp, iarg, refs;
-	struct arg *arg, *grp;
+	struct yacc_alts alts = {};
+	char name[32], *match;
+	unsigned icmd, i;
+	struct arg *grp;
 	struct cmd *cmd;
-	bool sep;
+	bool first;
 
+	ctx_numbergrps(ctx);
 	yacc_dumpheader(ctx);
 
 	fprintf(out, "%%%%\n\n");
 
 	icmd = 0;
 	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
-		if (icmd++ == 0)
+		match = expr_cmd(ctx, cmd);
+		yacc_getalts(ctx, &alts, &cmd->args, ++icmd, match, NULL,
+			     NULL);
+		free(match);
+	}
+
+	first = true;
+	for (icmd = 1; icmd <= ctx->cmdsnum; icmd++) {
+		for (i = 0; i < alts.num; i++) {
+			if (alts.alts[i].icmd == icmd)
+				break;
+		}
+		if (i == alts.num)
+			continue;
+		if (first)
 			fprintf(out, "commands: cmd%d\n", icmd);
 		else
 			fprintf(out, "        | cmd%d\n", icmd);
+		first = false;
 	}
 	fprintf(out, "\n");
 
@@ -942,108 +5297,333 @@ static void yacc_dump(struct ctx *ctx)
 
 	icmd = 0;
 	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
-		int cmdlen = 0;
+		snprintf(name, sizeof(name), "cmd%d", ++icmd);
+		yacc_dumpalts(ctx, name, &alts, icmd, -1);
 
-		refs = 0;
-		iarg = 0;
-		sep = false;
-		list_for_each_entry(arg, &cmd->args, argsent) {
-			if (iarg++ == 0)
-				cmdlen = fprintf(out, "cmd%d: ", icmd+1);
-			else if (sep) {
-				sep = false;
-				fprintf(out, "%*s%s", cmdlen - 2, "", "| ");
-			}
+		list_for_each_entry(grp, &cmd->optgrps, entry)
+			yacc_dumpgrp(ctx, grp);
+		list_for_each_entry(grp, &cmd->reqgrps, entry)
+			yacc_dumpgrp(ctx, grp);
+	}
+
+	fprintf(out, "%%%%\n\n");
 
-			refs = yacc_dumparg(ctx, arg, refs);
+	yacc_dumpoptcheck(ctx, &alts);
+	yacc_dumpfooter(ctx, &alts);
+	yacc_freealts(&alts);
+}
 
-			if (arg->flags & F_SEP ||
-			    list_is_last(&arg->argsent, &cmd->args)) {
-				sep = true;
-				fprintf(out, "\n");
-			} else
-				fprintf(out, " ");
+/*
+ * Usage of options only does not need a grammar: getopt_long()
+ * takes the options and the usage is checked by the set of seen
+ * options like the bison backend does.
+ */
+static int ctx_checkgetopt(struct ctx *ctx)
+{
+	struct hashed_args *hargs;
+
+	if (ctx->havetail || ctx->cachesize || ctx->bindpath || ctx->image ||
+	    ctx->peek) {
+		fprintf(stderr, "Error: --getopt can't be combined with '--' in usage, --cache, --bind, --image or --peek\n");
+		return -1;
+	}
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->optid < 0) {
+			fprintf(stderr, "Error: --getopt requires usage of options only, '%s' is not an option\n",
+				hargs->name);
+			return -1;
 		}
-		fprintf(out, "\n");
+		if (hargs->name[1] != '-' && strlen(hargs->name) != 2) {
+			fprintf(stderr, "Error: --getopt requires short options of one letter, '%s' is not\n",
+				hargs->name);
+			return -1;
+		}
+	}
 
-		igrp = 0;
-		list_for_each_entry(grp, &cmd->optgrps, entry) {
-			bool asreqgrp;
+	return 0;
+}
 
-			refs = 0;
-			iarg = 0;
-			sep = false;
-			asreqgrp = false;
+/*
+ * Arguments which only one usage line has go to the part of that line
+ * in the union of 'struct cli'.  Parts are numbered by usage lines.
+ */
+static int ctx_settagged(struct ctx *ctx)
+{
+	struct hashed_args *hargs;
+	struct arg *arg;
+	struct cmd *cmd;
+	unsigned icmd;
 
-			list_for_each_entry(arg, &grp->args, argsent) {
-				if (arg->flags & F_SEP) {
-					asreqgrp = true;
-					break;
-				}
-			}
-			list_for_each_entry(arg, &grp->args, argsent) {
-				if (iarg++ == 0)
-					fprintf(out, "%s:\n%*s | ", grp->name,
-						(int)strlen(grp->name) - 1,
-						"");
-				else if (sep) {
-					sep = false;
-					fprintf(out, "%*s | %s ",
-						(int)strlen(grp->name) - 1,
-						"", grp->name);
-				}
-
-				refs = yacc_dumparg(ctx, arg, refs);
-
-				if (!asreqgrp || arg->flags & F_SEP ||
-				    list_is_last(&arg->argsent, &grp->args)) {
-					sep = true;
-					fprintf(out, "\n");
-				} else
-					fprintf(out, " ");
-			}
-			fprintf(out, "\n");
-			igrp += 1;
+	if (ctx->getopt) {
+		fprintf(stderr, "Error: --union can't be combined with --getopt\n");
+		return -1;
+	}
+	/* Nothing overlaps in a single usage line */
+	if (ctx->cmdsnum < 2) {
+		ctx->tagged = false;
+		return 0;
+	}
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		arg = list_first_entry(&hargs->list, struct arg, hlistent);
+		if (!list_is_last(&arg->hlistent, &hargs->list))
+			continue;
+		icmd = 1;
+		list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+			if (cmd == arg->cmd)
+				break;
+			icmd++;
 		}
+		hargs->cmd = icmd;
+	}
+	/* Layout is the same if each argument is in several lines */
+	ctx->tagged = ctx_firstpart(ctx) != 0;
 
-		igrp = 0;
-		list_for_each_entry(grp, &cmd->reqgrps, entry) {
-			refs = 0;
-			iarg = 0;
-			sep = false;
-			list_for_each_entry(arg, &grp->args, argsent) {
-				if (iarg++ == 0)
-					fprintf(out, "%s: ", grp->name);
-				else if (sep) {
-					sep = false;
-					fprintf(out, "%*s ",
-						(int)strlen(grp->name) + 1,
-						"|");
-				}
-
-				refs = yacc_dumparg(ctx, arg, refs);
-
-				if (arg->flags & F_SEP ||
-				    list_is_last(&arg->argsent, &grp->args)) {
-					sep = true;
-					fprintf(out, "\n");
-				} else
-					fprintf(out, " ");
-			}
+	return 0;
+}
+
+static void getopt_dump(struct ctx *ctx)
+{
+	const char *header[] = {
+		"/*",
+		" * This is getopt_long() parser for command line interface",
+		" * generated by docopt.c.",
+		" */",
+		"",
+		"#include <stdio.h>",
+		"#include <stdlib.h>",
+		"#include <string.h>",
+		"#include <errno.h>",
+		"#include <getopt.h>",
+	};
+	const char *seen[] = {
+		"#define CLI_SEEN(id) (optseen[(id) / 8] & (1 << (id) % 8))",
+		"",
+		"/* Values of long options are ids, which follow all characters */",
+		"#define CLI_LONGOPT 0x100",
+		"",
+		"/* Details of the last failed parse, see @cli_lasterror() */",
+		"static struct @cli_error lasterr;",
+		"",
+	};
+	const char *option[] = {
+		"",
+		"static int cli_option(struct @cli *cli, int id, const char *val)",
+		"{",
+		"	optseen[id / 8] |= 1 << id % 8;",
+		"	switch (id) {",
+	};
+	const char *optid[] = {
+		"	}",
+		"",
+		"	return 0;",
+		"}",
+		"",
+		"static int cli_optid(int c)",
+		"{",
+		"	switch (c) {",
+	};
+	const char *optcheck[] = {
+		"	}",
+		"",
+		"	return c >= CLI_LONGOPT ? c - CLI_LONGOPT : -1;",
+		"}",
+		"",
+		"/* Seen options match one of usage lines */",
+		"static int cli_optcheck(void)",
+		"{",
+	};
+	const char *parse[] = {
+		"@fn int @cli_parse_alloc(int argc, char **argv, struct @cli *cli,",
+		"		    const struct @cli_allocator *alloc)",
+		"{",
+		"	int c, id, argi, rc = 0;",
+		"",
+		"	memset(cli, 0, sizeof(*cli));",
+		"	cli->_alloc = alloc ?: &cli_stdallocator;",
+		"	memset(optseen, 0, sizeof(optseen));",
+		"	memset(&lasterr, 0, sizeof(lasterr));",
+		"	lasterr.argi = -1;",
+		"	if (argc < 1) {",
+		"		lasterr.kind = CLI_ERR_SYNTAX;",
+		"		return -1;",
+		"	}",
+		"",
+		"	/*",
+		"	 * Zero restarts getopt_long(), which keeps its state between",
+		"	 * calls.  Leading '+' of the short options stops at the first",
+		"	 * non-option instead of permuting argv, ':' tells a missing",
+		"	 * value from an unknown option.  Nothing is printed.",
+		"	 */",
+		"	optind = 0;",
+		"	opterr = 0;",
+		"	for (argi = 1; !rc; argi = optind) {",
+		"		c = getopt_long(argc, argv, cli_shortopts, cli_longopts, NULL);",
+		"		if (c == -1)",
+		"			break;",
+		"		id = cli_optid(c);",
+		"		if (id >= 0) {",
+		"			rc = cli_option(cli, id, optarg);",
+		"			continue;",
+		"		}",
+		"		lasterr.kind = c == ':' ? CLI_ERR_MISSING : CLI_ERR_SYNTAX;",
+		"		lasterr.argi = argi;",
+		"		rc = -1;",
+		"	}",
+		"	/* Usage has no positional arguments */",
+		"	if (!rc && optind < argc) {",
+		"		lasterr.kind = CLI_ERR_SYNTAX;",
+		"		lasterr.argi = optind;",
+		"		rc = -1;",
+		"	} else if (!rc && !cli_optcheck()) {",
+		"		lasterr.kind = CLI_ERR_OPTIONS;",
+		"		rc = -1;",
+		"	} else if (!rc && !validating)",
+		"		rc = cli_env(cli);",
+		"	if (rc == -ENOMEM) {",
+		"		lasterr.kind = CLI_ERR_NOMEM;",
+		"		lasterr.argi = -1;",
+		"	}",
+		"	if (rc) {",
+	};
+	const char *parseend[] = {
+		"		@cli_free(cli);",
+		"	}",
+		"",
+		"	return rc;",
+		"}",
+		"",
+		"@fn int @cli_parse(int argc, char **argv, struct @cli *cli)",
+		"{",
+		"	return @cli_parse_alloc(argc, argv, cli, NULL);",
+		"}",
+		"",
+		"@fn const struct @cli_error *@cli_lasterror(void)",
+		"{",
+		"	return &lasterr;",
+		"}",
+		"",
+		"/* Options are not tokens, so only the end can be expected */",
+		"@fn const char *@cli_tokname(unsigned tok)",
+		"{",
+		"	return tok == 0 ? \"<end>\" : NULL;",
+		"}",
+	};
+	const char *validate[] = {
+		"",
+		"@fn int @cli_validate(int argc, char **argv)",
+		"{",
+		"	struct @cli cli;",
+		"	int rc;",
+		"",
+		"	validating = 1;",
+		"	rc = @cli_parse_alloc(argc, argv, &cli, NULL);",
+		"	validating = 0;",
+		"	if (rc)",
+		"		return rc;",
+		"",
+		"	/* The first usage line which fits the seen options */",
+	};
+	FILE *out = ctx->cout;
+	struct hashed_args *hargs;
+	struct cmd *cmd;
+	unsigned icmd;
+	char *match;
+	bool first;
+
+	print_tmpls(ctx, out, header, ARRAY_SIZE(header));
+	fprintf(out, "#include \"%s.h\"\n\n", ctx->basename);
+	code_dumpmacros(ctx, out);
+	print_tmpls(ctx, out, seen, ARRAY_SIZE(seen));
+	fprintf(out, "static unsigned char optseen[%u];\n\n",
+		ctx->optsnum / 8 + 1);
+
+	code_dumpstdalloc(ctx, out);
+	code_dumpresults(ctx, out);
+
+	/* Options which take a value are followed by ':' */
+	fprintf(out, "static const char cli_shortopts[] = \"+:");
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->name[1] != '-')
+			fprintf(out, "%c%s", hargs->name[1],
+				hargs->flags & F_VAL ? ":" : "");
+	}
+	fprintf(out, "\";\n\n");
+	fprintf(out, "static const struct option cli_longopts[] = {\n");
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->name[1] == '-')
+			fprintf(out, "	{ \"%s\", %s_argument, NULL, CLI_LONGOPT + %d },\n",
+				hargs->name + 2,
+				hargs->flags & F_VAL ? "required" : "no",
+				hargs->optid);
+	}
+	fprintf(out, "	{ NULL, 0, NULL, 0 },\n");
+	fprintf(out, "};\n");
+
+	print_tmpls(ctx, out, option, ARRAY_SIZE(option));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		fprintf(out, "	case %d:\n", hargs->optid);
+		if (hargs->flags & F_ARR) {
+			fprintf(out, "		");
+			print_strdup_arr(out, hargs, "val");
 			fprintf(out, "\n");
-			igrp += 1;
+		} else if (hargs->flags & F_VAL) {
+			/* The last one of repeating options wins */
+			fprintf(out, "		CLI_FREE(cli, cli->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, ");\n");
+			fprintf(out, "		CLI_STRDUP(cli, ");
+			print_strtolower(out, hargs->name);
+			fprintf(out, ", val);\n");
+		} else {
+			fprintf(out, "		cli->");
+			print_strtolower(out, hargs->name);
+			fprintf(out, " = 1;\n");
 		}
-		icmd += 1;
+		fprintf(out, "		break;\n");
 	}
-
-	fprintf(out, "%%%%\n");
-
-	yacc_dumpfooter(ctx);
+	print_tmpls(ctx, out, optid, ARRAY_SIZE(optid));
+	hash_for_each_entry(hargs, &ctx->uniqargs, hentry) {
+		if (hargs->name[1] != '-')
+			fprintf(out, "	case '%c':\n		return %d;\n",
+				hargs->name[1], hargs->optid);
+	}
+	print_tmpls(ctx, out, optcheck, ARRAY_SIZE(optcheck));
+	first = true;
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		match = expr_cmd(ctx, cmd);
+		fprintf(out, "%s(%s)", first ? "	return " : " ||\n		", match);
+		free(match);
+		first = false;
+	}
+	fprintf(out, ";\n}\n\n");
+	code_dumpenv(ctx, out);
+
+	print_tmpls(ctx, out, parse, ARRAY_SIZE(parse));
+	/* Usage lines have no positional prefix, unless there is one */
+	fprintf(out, "		lasterr.cmd = %d;\n", ctx->cmdsnum == 1);
+	print_tmpls(ctx, out, parseend, ARRAY_SIZE(parseend));
+	print_tmpls(ctx, out, validate, ARRAY_SIZE(validate));
+	icmd = 1;
+	list_for_each_entry(cmd, &ctx->cmds, cmdsent) {
+		if (list_is_last(&cmd->cmdsent, &ctx->cmds)) {
+			fprintf(out, "	return %u;\n}\n", icmd);
+			break;
+		}
+		match = expr_cmd(ctx, cmd);
+		fprintf(out, "	if (%s)\n		return %u;\n", match, icmd++);
+		free(match);
+	}
+	code_dumpvisit(ctx, out);
+	code_dumpmain(ctx, out);
 }
 
 void ctx_dump(struct ctx *ctx)
 {
 	hdr_dump(ctx);
+	if (ctx->getopt) {
+		getopt_dump(ctx);
+		return;
+	}
 	lex_dump(ctx);
 	yacc_dump(ctx);
 }
@@ -1078,6 +5658,61 @@ void ctx_onparsed(struct ctx *ctx)
 	}
 }
 
+/*
+ * Names of an option description are kept until the next one, so
+ * '[env: NAME]' on a continuation line goes to the same option.
+ */
+int ctx_optname(struct ctx *ctx, bool first, const char *name, size_t len)
+{
+	if (first) {
+		while (ctx->optnamesnum)
+			free(ctx->optnames[--ctx->optnamesnum]);
+	}
+	ctx->optnames = xrealloc(ctx->optnames, sizeof(*ctx->optnames) *
+				 (ctx->optnamesnum + 1));
+	ctx->optnames[ctx->optnamesnum] = strndup(name, len);
+	if (ctx->optnames[ctx->optnamesnum] == NULL)
+		return -ENOMEM;
+	ctx->optnamesnum++;
+
+	return 0;
+}
+
+/* Variable is bound to each name of the option which is in usage */
+int ctx_optenv(struct ctx *ctx, const char *name, size_t len)
+{
+	struct hashed_args *hargs;
+	unsigned i, found = 0;
+
+	if (!ctx->optnamesnum) {
+		fprintf(stderr, "Error: [env: %.*s] does not describe an option\n",
+			(int)len, name);
+		return -EINVAL;
+	}
+	for (i = 0; i < ctx->optnamesnum; i++) {
+		hargs = ctx_findarg(ctx, ctx->optnames[i]);
+		if (hargs == NULL)
+			continue;
+		if (hargs->env) {
+			fprintf(stderr, "Error: '%s' has more than one [env: ]\n",
+				hargs->name);
+			return -EINVAL;
+		}
+		hargs->env = strndup(name, len);
+		if (hargs->env == NULL)
+			return -ENOMEM;
+		ctx->envsnum++;
+		found++;
+	}
+	if (!found) {
+		fprintf(stderr, "Error: no '%s' of [env: %.*s] in usage\n",
+			ctx->optnames[0], (int)len, name);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 static void path_nosuff(const char *path, char *buf, size_t size)
 {
 	const char *end;
@@ -1089,33 +5724,43 @@ static void path_nosuff(const char *path, char *buf, size_t size)
 	buf[min] = '\0';
 }
 
+static FILE *ctx_openout(const char *filen, const char *suff)
+{
+	char path[PATH_MAX];
+	FILE *out;
+
+	snprintf(path, sizeof(path), "%s.%s", filen, suff);
+	out = fopen(path, "wx");
+	if (out == NULL)
+		perror(path);
+
+	return out;
+}
+
 static int ctx_setupout(struct ctx *ctx, const char *docoptpath)
 {
 	char filen[PATH_MAX-3];
-	char path[PATH_MAX];
 
 	path_nosuff(docoptpath, filen, sizeof(filen));
 	strncpy(ctx->basename, basename(filen), sizeof(ctx->basename) - 1);
 	ctx->basename[sizeof(ctx->basename) - 1] = '\0';
 
-	snprintf(path, sizeof(path), "%s.y", filen);
-	ctx->yyaccout = fopen(path, "wx");
-	if (ctx->yyaccout == NULL) {
-		perror(path);
-		return -1;
-	}
-	snprintf(path, sizeof(path), "%s.l", filen);
-	ctx->lexout = fopen(path, "wx");
-	if (ctx->lexout == NULL) {
-		perror(path);
-		return -1;
+	/* getopt_long() backend needs neither grammar nor scanner */
+	if (ctx->getopt) {
+		ctx->cout = ctx_openout(filen, "c");
+		if (ctx->cout == NULL)
+			return -1;
+	} else {
+		ctx->yyaccout = ctx_openout(filen, "y");
+		if (ctx->yyaccout == NULL)
+			return -1;
+		ctx->lexout = ctx_openout(filen, "l");
+		if (ctx->lexout == NULL)
+			return -1;
 	}
-	snprintf(path, sizeof(path), "%s.h", filen);
-	ctx->hdrout = fopen(path, "wx");
-	if (ctx->hdrout == NULL) {
-		perror(path);
+	ctx->hdrout = ctx_openout(filen, "h");
+	if (ctx->hdrout == NULL)
 		return -1;
-	}
 
 	return 0;
 }
@@ -1132,20 +5777,229 @@ static int ctx_setupin(struct ctx *ctx, const char *docoptpath)
 	return 0;
 }
 
-int main(int argc, char **argv)
+static int ctx_setcache(struct ctx *ctx, const char *size)
 {
-	struct ctx ctx;
-	int rc;
+	unsigned long num;
+	char *end;
+
+	errno = 0;
+	num = strtoul(size, &end, 10);
+	if (errno || *end || !num || num > 65536) {
+		fprintf(stderr, "Error: invalid cache size '%s'\n", size);
+		return -1;
+	}
+	ctx->cachesize = num;
+
+	return 0;
+}
+
+/*
+ * Bind file maps arguments to fields of an application struct, one
+ * per line, e.g. '--speed=<kn> -> struct ship_cfg.speed'.  Lines with
+ * '#include' are copied to the grammar, which needs the struct
+ * definition, other lines starting with '#' are comments.
+ */
+static int ctx_readbind(struct ctx *ctx)
+{
+	char line[256], name[128], type[64], field[64], extra;
+	struct hashed_args *hargs;
+	unsigned lineno = 0;
+	char *p, *incl;
+	FILE *in;
+	int rc = -1;
+
+	in = fopen(ctx->bindpath, "r");
+	if (in == NULL) {
+		perror(ctx->bindpath);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), in)) {
+		lineno++;
+		p = line + strspn(line, " \t");
+		if (!strncmp(p, "#include", 8)) {
+			incl = xasprintf("%s%s", ctx->bindincl ?: "", p);
+			free(ctx->bindincl);
+			ctx->bindincl = incl;
+			continue;
+		}
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+		if (sscanf(p, "%127s -> struct %63[A-Za-z0-9_].%63[A-Za-z0-9_] %c",
+			   name, type, field, &extra) != 3) {
+			fprintf(stderr, "%s:%u: Error: expected '<arg> -> struct <type>.<field>'\n",
+				ctx->bindpath, lineno);
+			goto out;
+		}
+		if (ctx->bindtype[0] && strcmp(ctx->bindtype, type)) {
+			fprintf(stderr, "%s:%u: Error: only one struct can be bound\n",
+				ctx->bindpath, lineno);
+			goto out;
+		}
+		strcpy(ctx->bindtype, type);
+
+		/* '--speed=<kn>' is '--speed', '<x>' is 'x' */
+		name[strcspn(name, "=")] = '\0';
+		p = name;
+		if (*p == '<' && p[strlen(p) - 1] == '>') {
+			p[strlen(p) - 1] = '\0';
+			p++;
+		}
+		hargs = ctx_findarg(ctx, p);
+		if (hargs == NULL) {
+			fprintf(stderr, "%s:%u: Error: no '%s' in usage\n",
+				ctx->bindpath, lineno, p);
+			goto out;
+		}
+		if (hargs->flags & F_ARR) {
+			fprintf(stderr, "%s:%u: Error: repeating '%s' can't be bound\n",
+				ctx->bindpath, lineno, p);
+			goto out;
+		}
+		if (hargs->bind) {
+			fprintf(stderr, "%s:%u: Error: '%s' is already bound\n",
+				ctx->bindpath, lineno, p);
+			goto out;
+		}
+		hargs->bind = strdup(field);
+		if (hargs->bind == NULL) {
+			perror("strdup");
+			goto out;
+		}
+		hargs->bindid = ctx->bindsnum++;
+	}
+	if (!ctx->bindsnum) {
+		fprintf(stderr, "%s: Error: nothing is bound\n", ctx->bindpath);
+		goto out;
+	}
+	rc = 0;
+out:
+	fclose(in);
+
+	return rc;
+}
+
+static int ctx_setprefix(struct ctx *ctx, const char *prefix)
+{
+	const char *p;
 
-	if (argc <= 1) {
-		fprintf(stderr, "Usage: [-i | <docopt>]\n");
+	if (strlen(prefix) >= sizeof(ctx->prefix) ||
+	    !(isalpha(*prefix) || *prefix == '_')) {
+		fprintf(stderr, "Error: invalid prefix '%s'\n", prefix);
 		return -1;
 	}
+	for (p = prefix; *p; p++) {
+		if (!isalnum(*p) && *p != '_') {
+			fprintf(stderr, "Error: invalid prefix '%s'\n", prefix);
+			return -1;
+		}
+	}
+	strcpy(ctx->prefix, prefix);
+	snprintf(ctx->yyprefix, sizeof(ctx->yyprefix), "%s_yy", prefix);
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: [-i | [--prefix=<name>] [--embed] [--cache=<n>] [--bind=<file>] [--getopt] [--runtime] [--union]\n"
+		"        [--image] [--peek] [--visit] [--fuzz] <docopt>]\n"
+		"\n"
+		"  --prefix=<name>  Prefix of generated symbols instead of 'cli'\n"
+		"  --embed          Generate parser as a single translation unit\n"
+		"                   with static functions\n"
+		"  --cache=<n>      Generate cli_parse_cached() with LRU cache\n"
+		"                   of <n> parse results\n"
+		"  --bind=<file>    Generate cli_parse_bind() which writes into\n"
+		"                   fields of a struct mapped by <file>\n"
+		"  --getopt         Generate C parser over getopt_long() instead\n"
+		"                   of grammar and scanner, usage must have\n"
+		"                   options only\n"
+		"  --runtime        Take helpers which do not depend on the spec\n"
+		"                   from libdocopt-rt instead of generating them\n"
+		"  --union          Put arguments of one usage line into a union\n"
+		"                   of 'struct cli' tagged by the matched line\n"
+		"  --image          Generate cli_serialize() and cli_view()\n"
+		"  --peek           Generate cli_peek() prefilter of arguments\n"
+		"  --visit          Generate cli_parse_visit() which streams\n"
+		"                   values of arrays to callbacks\n"
+		"  --fuzz           Generate fuzzing entry point under\n"
+		"                   FUZZ_EXAMPLE\n");
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "prefix",  required_argument, NULL, 'p' },
+		{ "embed",   no_argument,       NULL, 'e' },
+		{ "cache",   required_argument, NULL, 'c' },
+		{ "bind",    required_argument, NULL, 'b' },
+		{ "getopt",  no_argument,       NULL, 'g' },
+		{ "runtime", no_argument,       NULL, 'r' },
+		{ "union",   no_argument,       NULL, 'u' },
+		{ "image",   no_argument,       NULL, 'm' },
+		{ "peek",    no_argument,       NULL, 'k' },
+		{ "visit",   no_argument,       NULL, 'v' },
+		{ "fuzz",    no_argument,       NULL, 'f' },
+		{ NULL,      0,                 NULL,  0  },
+	};
+	const char *docoptpath = NULL;
+	struct ctx ctx;
+	int rc, opt;
 
 	ctx_init(&ctx);
 
-	if (0 == strcmp(argv[1], "-i")) {
-		ctx.interactive = true;
+	while ((opt = getopt_long(argc, argv, "i", options, NULL)) != -1) {
+		switch (opt) {
+		case 'i':
+			ctx.interactive = true;
+			break;
+		case 'p':
+			if (ctx_setprefix(&ctx, optarg))
+				return -1;
+			break;
+		case 'e':
+			ctx.embed = true;
+			break;
+		case 'c':
+			if (ctx_setcache(&ctx, optarg))
+				return -1;
+			break;
+		case 'b':
+			ctx.bindpath = optarg;
+			break;
+		case 'g':
+			ctx.getopt = true;
+			break;
+		case 'r':
+			ctx.runtime = true;
+			break;
+		case 'u':
+			ctx.tagged = true;
+			break;
+		case 'm':
+			ctx.image = true;
+			break;
+		case 'k':
+			ctx.peek = true;
+			break;
+		case 'v':
+			ctx.visit = true;
+			break;
+		case 'f':
+			ctx.fuzz = true;
+			break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+	if (ctx.interactive ? optind != argc : optind != argc - 1) {
+		usage();
+		return -1;
+	}
+	docoptpath = argv[optind];
+
+	if (ctx.interactive) {
 		/* This is a hack (or maybe not) to forcibly switch
 		   scanner to USAGE 'start condition' in order not
 		   to ask user to enter 'Usage:' */
@@ -1153,7 +6007,7 @@ int main(int argc, char **argv)
 		printf("Example: tool --version\n");
 		printf("> ");
 	} else {
-		rc = ctx_setupin(&ctx, argv[1]);
+		rc = ctx_setupin(&ctx, docoptpath);
 		if (rc)
 			return -1;
 	}
@@ -1163,7 +6017,22 @@ int main(int argc, char **argv)
 		rc = ctx_validate(&ctx);
 		if (rc)
 			goto out;
-		rc = ctx_setupout(&ctx, argv[1]);
+		if (ctx.bindpath) {
+			rc = ctx_readbind(&ctx);
+			if (rc)
+				goto out;
+		}
+		if (ctx.getopt) {
+			rc = ctx_checkgetopt(&ctx);
+			if (rc)
+				goto out;
+		}
+		if (ctx.tagged) {
+			rc = ctx_settagged(&ctx);
+			if (rc)
+				goto out;
+		}
+		rc = ctx_setupout(&ctx, docoptpath);
 		if (rc)
 			goto out;
 		ctx_dump(&ctx);
@@ -30,6 +30,7 @@ struct arg {
 	unsigned flags;
 	struct cmd *cmd;
 	char *name;
+	int grpid;                 /* group's alternative in 'grpalts' or -1 */
 	struct arg *prev;          /* prev argument in the stack */
 	struct list_head args;     /* list of children args in group */
 	struct list_head argsent;  /* entry in args of a parent group */
@@ -43,6 +44,11 @@ struct hashed_args {
 	char *name;
 	unsigned type;
 	unsigned flags;
+	int optid;                 /* bit in the set of seen options or -1 */
+	int bindid;                /* bit in the set of bound fields or -1 */
+	char *bind;                /* field of the bound struct or NULL */
+	char *env;                 /* variable of '[env: NAME]' or NULL */
+	unsigned cmd;              /* usage line of a field in the union or 0 */
 };
 
 struct cmd {
@@ -58,13 +64,35 @@ struct cmd {
 
 struct ctx {
 	char basename[32];
+	char prefix[32];            /* prefix of public symbols, 'cli' */
+	char yyprefix[40];          /* prefix of yacc & lex symbols, 'yy' */
 	FILE *in;
 	FILE *yyaccout;
 	FILE *lexout;
 	FILE *hdrout;
+	FILE *cout;                 /* parser of the getopt_long() backend */
 	bool interactive;
+	bool embed;                 /* single translation unit */
+	bool getopt;                /* getopt_long() backend instead of bison */
+	bool runtime;               /* helpers come from libdocopt-rt */
+	bool tagged;                /* fields of one usage line are in a union */
+	bool image;                 /* cli_serialize() and cli_view() */
+	bool peek;                  /* cli_peek() */
+	bool visit;                 /* cli_parse_visit() */
+	bool fuzz;                  /* fuzzing entry point */
+	unsigned cachesize;         /* entries of parse cache or 0 */
 	bool havearrays;
+	bool havetail;              /* arguments after '--' are passed through */
+	const char *bindpath;       /* file of --bind or NULL */
+	char bindtype[64];          /* tag of the bound struct */
+	char *bindincl;             /* '#include' lines of the bind file */
+	unsigned bindsnum;
+	char **optnames;            /* names of the last option description */
+	unsigned optnamesnum;
+	unsigned envsnum;
 	unsigned cmdsnum;
+	unsigned optsnum;
+	unsigned grpsnum;           /* groups which record their alternative */
 	struct list_head cmds;
 	struct hash_table uniqargs; /* hashed non-group unique args: hashed_args */
 };
@@ -86,6 +114,8 @@ int ctx_newcmd(struct ctx *ctx);
 int ctx_newarg(struct ctx *ctx, unsigned type, unsigned flags,
 	       const char *name, size_t len);
 void ctx_poparg(struct ctx *ctx);
+int ctx_optname(struct ctx *ctx, bool first, const char *name, size_t len);
+int ctx_optenv(struct ctx *ctx, const char *name, size_t len);
 struct cmd *ctx_lastcmd(struct ctx *ctx);
 
 #define CTX_ONERROR(ctx) ({				\
@@ -114,6 +144,18 @@ struct cmd *ctx_lastcmd(struct ctx *ctx);
 		return rc;					\
 })
 
+#define CTX_OPTNAME(ctx, first, ptr, len) ({		\
+	int rc = ctx_optname(ctx, first, ptr, len);		\
+	if (rc)							\
+		return rc;					\
+})
+
+#define CTX_OPTENV(ctx, ptr, len) ({				\
+	int rc = ctx_optenv(ctx, ptr, len);			\
+	if (rc)							\
+		return rc;					\
+})
+
 #define CMD_POP(ctx) ({						\
 	ctx_poparg(ctx);					\
 })
@@ -20,8 +20,8 @@ int yylex(void);
 
 %parse-param { struct ctx *ctx }
 
-%token <str> ARG OPTARG POSARG POSARG_DDD WORD
-%token EOL
+%token <str> ARG OPTARG POSARG POSARG_DDD WORD OPTNAME ENV
+%token EOL DDASH
 
 %start input
 
@@ -31,9 +31,21 @@ input: input line
      | line
 
 line: EOL                                    { ctx_oneol(ctx); }
-    | ARG { CTX_NEWCMD(ctx); } list-args EOL { ctx_onparsed(ctx); }
+    | ARG { CTX_NEWCMD(ctx); } list-args tail EOL { ctx_onparsed(ctx); }
+    | optdesc EOL
+    | ENV EOL                                { CTX_OPTENV(ctx, $1.ptr, $1.len); }
     | error EOL                              { CTX_ONERROR(ctx); }
 
+/* Arguments after '--' are passed through, the name is for usage only */
+tail: %empty
+    | DDASH                 { ctx->havetail = true; }
+    | DDASH POSARG_DDD      { ctx->havetail = true; }
+
+/* Description of an option in Options: section */
+optdesc: OPTNAME            { CTX_OPTNAME(ctx, true, $1.ptr, $1.len); }
+       | optdesc OPTNAME    { CTX_OPTNAME(ctx, false, $2.ptr, $2.len); }
+       | optdesc ENV        { CTX_OPTENV(ctx, $2.ptr, $2.len); }
+
 list-args: list-args '|' { ARG_SET(ctx, F_SEP); } arg
 		 | list-args arg
          | arg
@@ -0,0 +1,108 @@
+/*
+ * Every allocation of a parse fails in turn: nothing may leak, also
+ * when the scanner jumps out of flex through YY_FATAL_ERROR.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "alloc.h"
+
+static int failed;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failed = 1;						\
+	}								\
+} while (0)
+
+static int left;
+static int live;
+
+static void *fail_alloc(void *ctx, size_t size)
+{
+	void *ptr;
+
+	if (left-- == 0)
+		return NULL;
+	ptr = malloc(size);
+	live += !!ptr;
+	return ptr;
+}
+
+static void *fail_realloc(void *ctx, void *ptr, size_t size)
+{
+	void *newptr;
+
+	if (left-- == 0)
+		return NULL;
+	newptr = realloc(ptr, size);
+	live += newptr && !ptr;
+	return newptr;
+}
+
+static void fail_free(void *ctx, void *ptr)
+{
+	live -= !!ptr;
+	free(ptr);
+}
+
+static const struct cli_allocator failing = {
+	.alloc   = fail_alloc,
+	.realloc = fail_realloc,
+	.free    = fail_free,
+};
+
+static void test_parse(void)
+{
+	char *argv[] = { "prog", "add", "a", "--tag", "t", "b", "c", NULL };
+	struct cli cli;
+	int n, rc = -ENOMEM;
+
+	for (n = 0; rc == -ENOMEM; n++) {
+		left = n;
+		live = 0;
+		rc = cli_parse_alloc(7, argv, &cli, &failing);
+		if (rc == -ENOMEM)
+			CHECK(cli_lasterror()->kind == CLI_ERR_NOMEM);
+		else {
+			CHECK(rc == 0 && cli.file_num == 3 && !strcmp(cli.tag, "t"));
+			cli_free(&cli);
+		}
+		CHECK(live == 0);
+	}
+	CHECK(n > 1);
+}
+
+static void test_push(void)
+{
+	const char *args[] = { "move", "--force", "a", "b" };
+	struct cli cli;
+	int n, i, rc = -ENOMEM;
+
+	for (n = 0; rc == -ENOMEM; n++) {
+		left = n;
+		live = 0;
+		rc = cli_push_begin(&cli, &failing);
+		for (i = 0; !rc && i < 4; i++)
+			rc = cli_push_arg(&cli, args[i]);
+		if (!rc)
+			rc = cli_push_end(&cli);
+		if (!rc) {
+			CHECK(cli.move && cli.force && !strcmp(cli.to, "b"));
+			cli_free(&cli);
+		}
+		CHECK(rc == 0 || rc == -ENOMEM);
+		CHECK(live == 0);
+	}
+	CHECK(n > 1);
+}
+
+int main(void)
+{
+	test_parse();
+	test_push();
+
+	return failed;
+}
@@ -0,0 +1,63 @@
+/*
+ * Results of cli_parse_cached() are shared by arguments and variables
+ * of '[env: NAME]' options, a changed variable is parsed again.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+static int failed;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failed = 1;						\
+	}								\
+} while (0)
+
+static char *argv[] = { "prog", "ship", "a", NULL };
+static const int argc = 3;
+
+static const char *speed(void)
+{
+	const struct cli *cli = cli_parse_cached(argc, argv);
+
+	return cli && cli->speed ? cli->speed : "";
+}
+
+int main(void)
+{
+	struct cli_cachestats stats;
+	const struct cli *cli;
+
+	unsetenv("SHIP_SPEED");
+	unsetenv("SHIP_MOORED");
+	CHECK(!strcmp(speed(), ""));
+	setenv("SHIP_SPEED", "5", 1);
+	CHECK(!strcmp(speed(), "5"));
+	setenv("SHIP_SPEED", "7", 1);
+	CHECK(!strcmp(speed(), "7"));
+	CHECK(!strcmp(speed(), "7"));
+	cli_cache_stats(&stats);
+	CHECK(stats.hits == 1 && stats.misses == 3 && stats.entries == 3);
+
+	/* Unset and empty are different keys */
+	setenv("SHIP_SPEED", "", 1);
+	CHECK(!strcmp(speed(), ""));
+	unsetenv("SHIP_SPEED");
+	CHECK(!strcmp(speed(), ""));
+	cli_cache_stats(&stats);
+	CHECK(stats.hits == 2 && stats.misses == 4);
+
+	/* Flags as well */
+	setenv("SHIP_MOORED", "1", 1);
+	cli = cli_parse_cached(argc, argv);
+	CHECK(cli && cli->moored);
+	setenv("SHIP_MOORED", "0", 1);
+	cli = cli_parse_cached(argc, argv);
+	CHECK(cli && !cli->moored);
+	cli_cache_flush();
+
+	return failed;
+}
@@ -0,0 +1,101 @@
+/*
+ * Usage lines which are matched without scanner and parser, see
+ * cli_fastparse().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fast.h"
+
+static int failed;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failed = 1;						\
+	}								\
+} while (0)
+
+static unsigned allocs;
+
+static void *count_alloc(void *ctx, size_t size)
+{
+	allocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ctx, void *ptr, size_t size)
+{
+	allocs++;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *ctx, void *ptr)
+{
+	free(ptr);
+}
+
+static const struct cli_allocator counter = {
+	.alloc   = count_alloc,
+	.realloc = count_realloc,
+	.free    = count_free,
+};
+
+/* Parses words of 'line' separated by single spaces */
+static int parse(const char *line, struct cli *cli)
+{
+	static char buf[256];
+	char *argv[16];
+	int argc = 0;
+	char *s;
+
+	snprintf(buf, sizeof(buf), "prog %s", line);
+	for (s = strtok(buf, " "); s; s = strtok(NULL, " "))
+		argv[argc++] = s;
+	argv[argc] = NULL;
+	allocs = 0;
+
+	return cli_parse_alloc(argc, argv, cli, &counter);
+}
+
+int main(void)
+{
+	struct cli cli;
+	unsigned stop;
+
+	CHECK(parse("stop", &cli) == 0);
+	CHECK(cli.stop && !cli.force);
+	stop = allocs;
+	cli_free(&cli);
+
+	/* Group of options before a positional */
+	CHECK(parse("--verbose x", &cli) == 0);
+	CHECK(cli.verbose && cli.x && !strcmp(cli.x, "x"));
+	/* Matched in the fast path: one more string, no scanner buffers */
+	CHECK(allocs == stop + 1);
+	cli_free(&cli);
+
+	CHECK(parse("x", &cli) == 0);
+	CHECK(!cli.verbose && cli.x && !strcmp(cli.x, "x"));
+	cli_free(&cli);
+
+	/* Tokens of the line above are left in the stack of the fast path */
+	CHECK(parse("--verbose", &cli) != 0);
+	CHECK(cli_lasterror()->kind == CLI_ERR_MISSING);
+
+	CHECK(parse("run -q a b", &cli) == 0);
+	CHECK(cli.run && cli.q && !strcmp(cli.y, "a") && !strcmp(cli.z, "b"));
+	CHECK(allocs == stop + 2);
+	cli_free(&cli);
+
+	CHECK(parse("run a -q b", &cli) == 0);
+	CHECK(cli.run && cli.q && !strcmp(cli.y, "a") && !strcmp(cli.z, "b"));
+	cli_free(&cli);
+
+	CHECK(parse("run a", &cli) != 0);
+	CHECK(parse("x y", &cli) != 0);
+	CHECK(parse("stop --verbose", &cli) != 0);
+	CHECK(cli_lasterror()->kind == CLI_ERR_OPTIONS);
+
+	return failed;
+}
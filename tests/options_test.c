@@ -0,0 +1,126 @@
+/*
+ * Options are taken in any position and checked against the usage
+ * line by the set of seen options, see cli_optcheck().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "options.h"
+
+static int failed;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failed = 1;						\
+	}								\
+} while (0)
+
+static char *argv[16];
+static int argc;
+
+/* Splits words of 'line' separated by single spaces into argv */
+static void split(const char *line)
+{
+	static char buf[256];
+	char *s;
+
+	snprintf(buf, sizeof(buf), "prog %s", line);
+	argc = 0;
+	for (s = strtok(buf, " "); s; s = strtok(NULL, " "))
+		argv[argc++] = s;
+	argv[argc] = NULL;
+}
+
+static int parse(const char *line, struct cli *cli)
+{
+	split(line);
+	return cli_parse(argc, argv, cli);
+}
+
+/* The same argv pushed one by one */
+static int push(const char *line, struct cli *cli)
+{
+	int rc, i;
+
+	split(line);
+	rc = cli_push_begin(cli, NULL);
+	for (i = 1; !rc && i < argc; i++)
+		rc = cli_push_arg(cli, argv[i]);
+
+	return rc ?: cli_push_end(cli);
+}
+
+static int (*const modes[])(const char *, struct cli *) = { parse, push };
+
+static int fails(int (*mode)(const char *, struct cli *), const char *line,
+		 int kind)
+{
+	struct cli cli;
+
+	return mode(line, &cli) == -1 && cli_lasterror()->kind == kind;
+}
+
+int main(void)
+{
+	int (*mode)(const char *, struct cli *);
+	struct cli cli;
+	unsigned i;
+
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		mode = modes[i];
+
+		/* Nothing given is missing, not a mismatch of options */
+		CHECK(fails(mode, "", CLI_ERR_MISSING));
+		CHECK(cli_lasterror()->argi == 1);
+
+		/* Required group of a positional and an option */
+		CHECK(mode("add f", &cli) == 0);
+		CHECK(cli.add && !strcmp(cli.file, "f") && !cli.all);
+		cli_free(&cli);
+		CHECK(mode("add --all", &cli) == 0);
+		CHECK(cli.add && cli.all && !cli.file);
+		cli_free(&cli);
+		CHECK(mode("--dry-run add --all", &cli) == 0);
+		CHECK(cli.add && cli.all && cli.dryrun);
+		cli_free(&cli);
+		CHECK(fails(mode, "add", CLI_ERR_OPTIONS));
+		CHECK(fails(mode, "add f --all", CLI_ERR_OPTIONS));
+		CHECK(fails(mode, "--all add f", CLI_ERR_OPTIONS));
+
+		/* Options of another line */
+		CHECK(fails(mode, "ship a move 1 2 --all", CLI_ERR_OPTIONS));
+		CHECK(fails(mode, "--version add f", CLI_ERR_OPTIONS));
+
+		CHECK(mode("ship a move --speed=5 1 2", &cli) == 0);
+		CHECK(!strcmp(cli.speed, "5") && !strcmp(cli.y, "2"));
+		cli_free(&cli);
+		CHECK(mode("ship a --speed 5 move 1 2", &cli) == 0);
+		CHECK(!strcmp(cli.speed, "5") && !strcmp(cli.name, "a"));
+		cli_free(&cli);
+		CHECK(mode("ship a move 1 2 --sp=5", &cli) == 0);
+		CHECK(!strcmp(cli.speed, "5"));
+		cli_free(&cli);
+
+		/* Empty value after '=' doesn't take the next argument */
+		CHECK(mode("ship a move 1 2 --speed=", &cli) == 0);
+		CHECK(cli.speed && !strcmp(cli.speed, ""));
+		cli_free(&cli);
+		CHECK(mode("ship a move 1 --speed= 2", &cli) == 0);
+		CHECK(cli.speed && !strcmp(cli.speed, "") && !strcmp(cli.y, "2"));
+		cli_free(&cli);
+		CHECK(fails(mode, "ship a move 1 2 --speed= 3", CLI_ERR_SYNTAX));
+		CHECK(cli_lasterror()->argi == 7);
+		CHECK(fails(mode, "ship a move 1 2 --speed", CLI_ERR_MISSING));
+
+		CHECK(mode("-h", &cli) == 0);
+		CHECK(cli.h && !cli.help);
+		cli_free(&cli);
+		CHECK(mode("--version", &cli) == 0);
+		CHECK(cli.version);
+		cli_free(&cli);
+		CHECK(fails(mode, "--version --help", CLI_ERR_OPTIONS));
+	}
+
+	return failed;
+}
@@ -0,0 +1,277 @@
+/*
+ * Commands registered at runtime next to the spec, see cli_dispatch()
+ * and docopt-rt.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "plugins.h"
+
+static int failed;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failed = 1;						\
+	}								\
+} while (0)
+
+static const char *called;
+
+static int handler(const struct docopt_match *m, void *ctx)
+{
+	called = m->usage;
+	return 7;
+}
+
+/* Dispatches words of 'line' separated by single spaces */
+static int dispatch(const char *line, struct cli *cli, int *status)
+{
+	static char buf[256];
+	char *argv[16];
+	int argc = 0;
+	char *s;
+
+	snprintf(buf, sizeof(buf), "naval_fate %s", line);
+	for (s = strtok(buf, " "); s; s = strtok(NULL, " "))
+		argv[argc++] = s;
+	argv[argc] = NULL;
+	called = NULL;
+	*status = 0;
+
+	return cli_dispatch(argc, argv, cli, status);
+}
+
+/* Values of options which some line takes are skipped */
+static void test_cmdword(void)
+{
+	char *argv[] = { "prog", "--format", "json", "-v", "stat", NULL };
+	struct docopt_registry reg = { 0 };
+
+	CHECK(docopt_cmdword(&reg, 5, argv) == 2);
+	CHECK(docopt_register(&reg, "stat [--format=<fmt>]", handler, NULL) == 0);
+	CHECK(docopt_register(&reg, "show [--format=<fmt>] [-v]", handler, NULL) == 0);
+	CHECK(docopt_cmdword(&reg, 5, argv) == 4);
+	CHECK(docopt_unregister(&reg, "stat [--format=<fmt>]") == 0);
+	CHECK(docopt_cmdword(&reg, 5, argv) == 4);
+	CHECK(docopt_unregister(&reg, "show [--format=<fmt>] [-v]") == 0);
+	CHECK(docopt_cmdword(&reg, 5, argv) == 2);
+	CHECK(docopt_register(&reg, "show [-v=<level>]", handler, NULL) == 0);
+	CHECK(docopt_cmdword(&reg, 5, argv) == 2);
+	argv[1] = "-v";
+	argv[3] = "--format";
+	CHECK(docopt_cmdword(&reg, 5, argv) == 4);
+	docopt_registryfree(&reg);
+}
+
+static const char *vals[4];
+
+/* Keeps '<a>' and values of '<b>...' */
+static int keep(const struct docopt_match *m, void *ctx)
+{
+	unsigned i;
+
+	vals[0] = docopt_matchstr(m, "<a>");
+	for (i = 0; i < 3; i++)
+		vals[i + 1] = docopt_matcharr(m, "<b>", i);
+
+	return docopt_matchnum(m, "<b>");
+}
+
+static int dispatchreg(const struct docopt_registry *reg, char **argv)
+{
+	int argc, status = -1, argi;
+
+	for (argc = 0; argv[argc]; argc++)
+		;
+	memset(vals, 0, sizeof(vals));
+
+	return docopt_dispatch(reg, argc, argv, &status, &argi) > 0 ? status : -1;
+}
+
+/* Optional arguments leave the required '<b>...' its arguments */
+static void test_optional(void)
+{
+	char *one[] = { "prog", "cp", "x", NULL };
+	char *two[] = { "prog", "cp", "-n", "3", "x", "y", NULL };
+	char *three[] = { "prog", "cp", "x", "--", "y", "-z", NULL };
+	struct docopt_registry reg = { 0 };
+
+	CHECK(docopt_register(&reg, "cp [-n=<num>] [<a>] <b>...", keep, NULL) == 0);
+	CHECK(dispatchreg(&reg, one) == 1);
+	CHECK(!vals[0] && !strcmp(vals[1], "x") && !vals[2]);
+	CHECK(dispatchreg(&reg, two) == 1);
+	CHECK(!strcmp(vals[0], "x") && !strcmp(vals[1], "y") && !vals[2]);
+	CHECK(dispatchreg(&reg, three) == 2);
+	CHECK(!strcmp(vals[0], "x") && !strcmp(vals[1], "y") &&
+	      !strcmp(vals[2], "-z") && !vals[3]);
+	one[2] = NULL;
+	CHECK(dispatchreg(&reg, one) == -1);
+	docopt_registryfree(&reg);
+}
+
+static const char spec[] =
+	"Naval Fate.\n"
+	"\n"
+	"Usage:\n"
+	"  naval_fate ship new <name>...\n"
+	"  naval_fate ship <name> move <x> <y> [--speed=<kn>]\n"
+	"  naval_fate ship shoot <x> <y>\n"
+	"  naval_fate mine (set|remove) <x> <y> [--moored|--drifting]\n"
+	"  naval_fate -h | --help\n"
+	"  naval_fate --version\n"
+	"\n"
+	"Options:\n"
+	"  --speed=<kn>  Speed in knots.\n";
+
+/* Lines of a spec are registered all or none */
+static void test_registerspec(void)
+{
+	char *shoot[] = { "prog", "ship", "shoot", "1", "2", NULL };
+	char *mine[] = { "prog", "mine", "remove", "1", "2", "--drifting", NULL };
+	char *both[] = { "prog", "mine", "set", "1", "2", "--moored",
+			 "--drifting", NULL };
+	struct docopt_registry reg = { 0 };
+	unsigned num;
+
+	CHECK(docopt_registerspec(&reg, spec, handler, NULL) == 0);
+	num = reg.num;
+	CHECK(num == 12);
+	CHECK(dispatchreg(&reg, shoot) == 7);
+	CHECK(called && !strcmp(called, "ship shoot <x> <y>"));
+	CHECK(dispatchreg(&reg, mine) == 7);
+	CHECK(called && !strcmp(called, "mine remove <x> <y> --drifting"));
+	CHECK(dispatchreg(&reg, both) == -1);
+
+	CHECK(docopt_registerspec(&reg, spec, handler, NULL) == -EEXIST);
+	CHECK(docopt_registerspec(&reg, "Usage: prog stat <id>\n"
+				  "  prog ship new <name>...\n",
+				  handler, NULL) == -EEXIST);
+	CHECK(docopt_registerspec(&reg, "Usage: prog stat <id>\n"
+				  "  prog stat [<a>] <b>\n",
+				  handler, NULL) == -EINVAL);
+	CHECK(reg.num == num);
+	shoot[1] = "stat";
+	CHECK(dispatchreg(&reg, shoot) == -1);
+	docopt_registryfree(&reg);
+}
+
+/* Handlers of one registry return its generation */
+static int generation(const struct docopt_match *m, void *ctx)
+{
+	return (int)(long)ctx;
+}
+
+#define LIVE_READERS 4
+#define LIVE_SWAPS 200
+
+static struct docopt_live *live;
+static atomic_int livedone;
+static atomic_int livebad;
+
+static void *livereader(void *arg)
+{
+	char *argv[] = { "prog", "ship", "new", "a", NULL };
+	int last = 0, status, argi;
+
+	while (!atomic_load(&livedone)) {
+		if (docopt_livedispatch(live, 4, argv, &status, &argi) != 1 ||
+		    status < last || status > LIVE_SWAPS)
+			atomic_fetch_add(&livebad, 1);
+		else
+			last = status;
+	}
+
+	return arg;
+}
+
+/* Registries are swapped while readers dispatch */
+static void test_live(void)
+{
+	struct docopt_registry reg = { 0 };
+	pthread_t readers[LIVE_READERS];
+	long gen;
+	int i;
+
+	live = docopt_livenew();
+	CHECK(live != NULL);
+	CHECK(docopt_registerspec(&reg, spec, generation, (void *)0L) == 0);
+	CHECK(docopt_liveswap(live, &reg) == 0);
+	CHECK(reg.num == 0 && reg.nbuckets == 0);
+	for (i = 0; i < LIVE_READERS; i++)
+		CHECK(pthread_create(&readers[i], NULL, livereader, NULL) == 0);
+	for (gen = 1; gen <= LIVE_SWAPS; gen++) {
+		CHECK(docopt_registerspec(&reg, spec, generation, (void *)gen) == 0);
+		CHECK(docopt_liveswap(live, &reg) == 0);
+	}
+	atomic_store(&livedone, 1);
+	for (i = 0; i < LIVE_READERS; i++)
+		pthread_join(readers[i], NULL);
+	CHECK(atomic_load(&livebad) == 0);
+	docopt_livefree(live);
+}
+
+int main(void)
+{
+	struct cli cli;
+	int status;
+
+	test_cmdword();
+	test_optional();
+	test_registerspec();
+	test_live();
+
+	/* Words of the spec */
+	CHECK(cli_register("ship <name>", handler, NULL) == -EEXIST);
+	CHECK(cli_register("mine", handler, NULL) == -EEXIST);
+
+	CHECK(cli_register("stat <id> [--format=<fmt>]", handler, NULL) == 0);
+	CHECK(cli_register("<a> <b> <c> <d>", handler, NULL) == 0);
+	CHECK(cli_register("--version", handler, NULL) == 0);
+
+	CHECK(dispatch("stat 1 --format=json", &cli, &status) == 1);
+	CHECK(status == 7 && called && !strcmp(called, "stat <id> [--format=<fmt>]"));
+	cli_free(&cli);
+
+	/* Value of an option of a registered line is not the command word */
+	CHECK(dispatch("--format json stat 1", &cli, &status) == 1);
+	CHECK(called && !strcmp(called, "stat <id> [--format=<fmt>]"));
+	cli_free(&cli);
+
+	/* Lines without command word don't take lines of the spec */
+	CHECK(dispatch("ship shoot 1 2", &cli, &status) == 0);
+	CHECK(!called && cli.ship && cli.shoot && !strcmp(cli.x, "1"));
+	cli_free(&cli);
+	CHECK(dispatch("--version", &cli, &status) == 0);
+	CHECK(!called && cli.version);
+	cli_free(&cli);
+
+	/* ... but take what the spec doesn't */
+	CHECK(dispatch("a b c d", &cli, &status) == 1);
+	CHECK(status == 7 && called && !strcmp(called, "<a> <b> <c> <d>"));
+	cli_free(&cli);
+
+	/* Registered word with a bad line, the last argument is extra */
+	CHECK(dispatch("stat 1 2", &cli, &status) == -1);
+	CHECK(cli_lasterror()->kind == CLI_ERR_SYNTAX);
+	CHECK(cli_lasterror()->argi == 3);
+	CHECK(dispatch("stat", &cli, &status) == -1);
+	CHECK(cli_lasterror()->kind == CLI_ERR_MISSING);
+
+	/* Spec error is kept if no line without command word matches */
+	CHECK(dispatch("ship shoot 1", &cli, &status) == -1);
+	CHECK(!called && cli_lasterror()->kind == CLI_ERR_MISSING);
+
+	CHECK(cli_unregister("stat <id> [--format=<fmt>]") == 0);
+	CHECK(cli_unregister("stat <id> [--format=<fmt>]") == -ENOENT);
+	CHECK(cli_unregister("<a> <b> <c> <d>") == 0);
+	CHECK(cli_unregister("--version") == 0);
+	CHECK(dispatch("ship new a", &cli, &status) == 0);
+	CHECK(cli.new && cli.name_num == 1);
+	cli_free(&cli);
+
+	return failed;
+}